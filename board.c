@@ -46,6 +46,8 @@ int CheckBoard(const S_BOARD *pos) {
 	//this is the number of minor pieces for each side that is bishop or knight
 	int t_material[2] = { 0, 0};
     //this is the material score for each side
+	int t_psq = 0;
+    //the piece-square score, recomputed to check the one MakeMove keeps
 	int sq64,t_piece,t_pce_num,sq120,colour,pcount;
 	//these are the square, the piece, the piece number, the square 120, the colour and the piece count
 	U64 t_pawns[3] = {0ULL, 0ULL, 0ULL};
@@ -76,6 +78,7 @@ int CheckBoard(const S_BOARD *pos) {
 		if( PieceMaj[t_piece] == TRUE) t_majPce[colour]++;//if the piece is a major piece increment the number of major pieces
 
 		t_material[colour] += PieceVal[t_piece];//increment the material score for that colour
+		t_psq += PieceSquare[t_piece][sq120];
 	}
 
 	for(t_piece = wP; t_piece <= bK; ++t_piece) {//for all the pieces
@@ -109,6 +112,8 @@ int CheckBoard(const S_BOARD *pos) {
 
 	ASSERT(t_material[WHITE]==pos->material[WHITE] && t_material[BLACK]==pos->material[BLACK]);
 	//assert that the material score for both sides is the same as the material score in the position
+	ASSERT(t_psq==pos->psq);
+	ASSERT(GenerateMaterialKey(pos)==pos->materialKey);
 	ASSERT(t_minPce[WHITE]==pos->minPce[WHITE] && t_minPce[BLACK]==pos->minPce[BLACK]);
 	//assert that the number of minor pieces for both sides is the same as the number of minor pieces in the position
 	ASSERT(t_majPce[WHITE]==pos->majPce[WHITE] && t_majPce[BLACK]==pos->majPce[BLACK]);
@@ -118,6 +123,7 @@ int CheckBoard(const S_BOARD *pos) {
 
 	ASSERT(pos->side==WHITE || pos->side==BLACK);//assert that the side to move is either white or black
 	ASSERT(GeneratePosKey(pos)==pos->posKey);//assert that the position key is the same as the generated position key
+	ASSERT(GeneratePawnKey(pos)==pos->pawnKey);
 
 	ASSERT(pos->enPas==NO_SQ || ( RanksBrd[pos->enPas]==RANK_6 && pos->side == WHITE)
 		 || ( RanksBrd[pos->enPas]==RANK_3 && pos->side == BLACK));
@@ -149,6 +155,7 @@ void UpdateListsMaterial(S_BOARD *pos) {
 		    if( PieceMaj[piece] == TRUE) pos->majPce[colour]++;
 
 			pos->material[colour] += PieceVal[piece];
+			pos->psq += PieceSquare[piece][sq];
 
 			ASSERT(pos->pceNum[piece] < 10 && pos->pceNum[piece] >= 0);
 
@@ -168,6 +175,8 @@ void UpdateListsMaterial(S_BOARD *pos) {
 			}
 		}
 	}
+
+	pos->materialKey = GenerateMaterialKey(pos);
 }
 
 int ParseFen(char *fen, S_BOARD *pos) {
@@ -269,6 +278,7 @@ int ParseFen(char *fen, S_BOARD *pos) {
     }
 
 	pos->posKey = GeneratePosKey(pos);
+	pos->pawnKey = GeneratePawnKey(pos);
 
 	UpdateListsMaterial(pos);
 
@@ -297,6 +307,8 @@ void ResetBoard(S_BOARD *pos) {
 	for(index = 0; index < 3; ++index) {
 		pos->pawns[index] = 0ULL;
 	}
+	pos->psq = 0;
+	pos->materialKey = 0ULL;
 
 	for(index = 0; index < 13; ++index) {
 		pos->pceNum[index] = 0;
@@ -385,6 +397,7 @@ void MirrorBoard(S_BOARD *pos) {
     pos->enPas = tempEnPas;
 
     pos->posKey = GeneratePosKey(pos);
+    pos->pawnKey = GeneratePawnKey(pos);
 
 	UpdateListsMaterial(pos);
 
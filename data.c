@@ -12,6 +12,7 @@ int PieceMaj[13] = { FALSE, FALSE, FALSE, FALSE, TRUE, TRUE, TRUE, FALSE, FALSE,
 int PieceMin[13] = { FALSE, FALSE, TRUE, TRUE, FALSE, FALSE, FALSE, FALSE, TRUE, TRUE, FALSE, FALSE, FALSE };//minors are bishops and knights  
 int PieceVal[13]= { 0, 100, 325, 325, 550, 1000, 50000, 100, 325, 325, 550, 1000, 50000  };
                    //  wP,   wN,  wB , wR,  wQ ,  wK  ,  bP,  bN , bB, bR , bQ  ,   bK
+int PiecePhase[13] = { 0, 0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0 };
 int PieceCol[13] = { BOTH, WHITE, WHITE, WHITE, WHITE, WHITE, WHITE,
 	BLACK, BLACK, BLACK, BLACK, BLACK, BLACK };
 	
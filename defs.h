@@ -3,10 +3,11 @@
 
 #include "stdlib.h"
 #include "stdio.h"
+#include "stdatomic.h"
 
 // #define DEBUG
 
-#define MAX_HASH 1024
+#define MAX_HASH 262144 //256 GB
 
 #ifndef DEBUG
 #define ASSERT(n)
@@ -29,9 +30,16 @@ typedef unsigned long long U64;
 #define MAXGAMEMOVES 2048
 #define MAXPOSITIONMOVES 256
 #define MAXDEPTH 64
+#define MOVE_OVERHEAD 50
+#define BENCH_DEPTH 7
+#define MAX_MULTIPV 8
+#define LAZY_MARGIN 200 //default for the LazyMargin option
+#define INPUTBUFFER 400 * 6
 
 #define START_FEN  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 
+#define HISTORY_MAX 16384
+
 #define INFINITE 30000
 #define ISMATE (INFINITE - MAXDEPTH)
 
@@ -66,25 +74,67 @@ typedef struct {
 	int count;
 } S_MOVELIST;
 
+typedef struct {
+	int move;
+	int score;//exact score from the last search of this move, -INFINITE if it did not beat the best line
+	long nodes;//nodes spent below this move, orders the moves that failed low at the next iteration
+	int pv[MAXDEPTH];
+	int pvLength;
+} S_ROOTMOVE;
+
 enum {  HFNONE, HFALPHA, HFBETA, HFEXACT};
 
+//quiescence results are stored below any main search depth, check evasions one step above plain captures
+#define QS_DEPTH_EVASION 0
+#define QS_DEPTH -1
+#define NO_EVAL 32000 //no static evaluation known, outside every real score
+
+// A packed score holds the middlegame value in the low 16 bits and the endgame value above it,
+// so both halves are added or subtracted with one instruction. The endgame half is read back
+// rounded, which undoes the borrow a negative middlegame value takes from it.
+#define S(mg, eg) ((int)((unsigned int)(eg) << 16) + (mg))
+#define MG_SCORE(s) ((short)(unsigned short)(unsigned int)(s))
+#define EG_SCORE(s) ((short)(unsigned short)(((unsigned int)(s) + 0x8000) >> 16))
+#define PHASE_TOTAL 24 //knights and bishops count 1, rooks 2, queens 4
+
+// A hash entry is two 64-bit words, 16 bytes, and a bucket of 4 fills one 64-byte cache line,
+// so a probe costs a single cache miss. The bucket is chosen from the whole key, and the full
+// key is checked on a probe.
+// Data bits: score 0-15, static eval 16-31, move 32-46 (from64 | to64 << 6 | N,B,R,Q as 1-4 << 12),
+// depth + HASH_DEPTH_OFFSET 47-53, bound 54-55, generation 56-63.
+// The other word is the position key xor the data, so an entry only matches when both words
+// come from the same store: threads sharing the table may tear an entry between the two
+// words, that is then seen as a miss, and no locks are needed.
+#define HASH_ENTRY_FORMAT 3 //changes with the layout above, saved tables of another format are refused
+#define HASH_BUCKET_SIZE 4
+#define HASH_DEPTH_OFFSET 2 //stored depth is depth + offset, 0 marks an empty entry
+#define HASH_GEN_MASK 0xFF //eight generation bits, one search ages an entry by one
+#define HASHFULL_SAMPLE 1000 //entries looked at for the hashfull estimate
+
 typedef struct {//hash entry
-	U64 posKey;//This is a 64-bit unsigned integer that represents the key for a specific board position. It's likely generated using a method called Zobrist hashing, which is a common technique in chess programming for efficiently representing board positions.
-	int move;// This represents the move that was made to reach the current position from the parent position in the search tree.
-	int score;// This is the evaluation score of the position, as determined by the search algorithm. Higher scores typically indicate better positions for the side to move.
-	int depth;//the depth of the search
-	int flags;
-} S_HASHENTRY;//hash entry
-
-typedef struct {//it is used 
-	S_HASHENTRY *pTable;
-	int numEntries;
-	int newWrite;
-	int overWrite;
-	int hit;
-	int cut;
+	_Atomic U64 key;
+	_Atomic U64 data;
+} S_HASHENTRY;
+
+typedef struct {
+	S_HASHENTRY entry[HASH_BUCKET_SIZE];
+} S_HASHBUCKET;
+
+typedef struct {//one table shared by every searching thread
+	S_HASHBUCKET *pTable;
+	U64 numBuckets;
+	int generation;//advanced once per search, entries from older searches are replaced first
+	void *mapping;//the file the table was loaded from, NULL when it was allocated
+	U64 mappingSize;
 } S_HASHTABLE;
 
+typedef struct {//counted by each thread on its own board, added up only when reported
+	long newWrite;
+	long overWrite;
+	long hit;
+	long cut;
+} S_HASHSTATS;
+
 typedef struct {
 
 	int move;
@@ -95,6 +145,35 @@ typedef struct {
 
 } S_UNDO;
 
+#define PAWN_HASH_ENTRIES 16384 //a power of two, a search meets a few thousand pawn structures
+
+typedef struct {//what the eval knows from the pawns alone
+	U64 pawnKey;
+	U64 passed[2];//passed pawns of each side
+	int score;//packed pawn structure terms, white minus black
+	int semiOpen[2];//one bit per file without a pawn of that side
+} S_PAWNENTRY;
+
+typedef struct {
+	S_PAWNENTRY entry[PAWN_HASH_ENTRIES];
+	long hit;
+	long miss;
+} S_PAWNTABLE;
+
+typedef struct {//counted by the search on its own board, reported after each UCI search and by Bench
+	long hashEval;//static evals found in the hash table
+	long computed;//static evals the search had to work out
+	long lazy;//of those, early exits on the material and piece-square estimate
+	long lazyChecked;//early exits checked against a full eval (LazyCheck)
+	long lazyWrong;//and the ones the full eval put on the other side of the window
+} S_EVALSTATS;
+
+#define MATERIAL_HASH_ENTRIES 8192 //a power of two, material only changes on captures and promotions
+#define SCALE_NORMAL 64 //the scale factor that leaves the evaluation as it is
+#define KNOWN_WIN 10000 //a won endgame, well clear of the material but below every mate score
+
+typedef struct S_MATERIALTABLE S_MATERIALTABLE;//defined below S_BOARD, its entries point at evaluators taking a board
+
 typedef struct {
 
 	int pieces[BRD_SQ_NUM];
@@ -112,43 +191,89 @@ typedef struct {
 	int castlePerm;
 
 	U64 posKey;
+	U64 pawnKey;//the pawns only, kept up to date by MakeMove
+	U64 materialKey;//the piece counts only, kept up to date by MakeMove
 
 	int pceNum[13];
 	int bigPce[2];
 	int majPce[2];
 	int minPce[2];
 	int material[2];
+	int psq;//packed piece-square score, white minus black, kept up to date by MakeMove
 
 	S_UNDO history[MAXGAMEMOVES];
 
 	// piece list
 	int pList[13][10];//the piece list used to store the pieces on the board and their positions
 
-	S_HASHTABLE HashTable[1];
-	int PvArray[MAXDEPTH];
+	S_HASHTABLE *HashTable;//shared with the other threads
+	S_PAWNTABLE *PawnTable;//pawn structure terms by pawn key, see pawns.c
+	S_MATERIALTABLE *MaterialTable;//phase, scaling and endgame evaluator by material key, see material.c
+	S_HASHSTATS hashStats;
+	S_EVALSTATS evalStats;
+	//triangular PV table, row ply holds the best line found from that ply (columns ply to pvLength[ply]-1),
+	//a node copies its child's row behind its own move whenever alpha goes up
+	int pvTable[MAXDEPTH + 1][MAXDEPTH + 1];
+	int pvLength[MAXDEPTH + 1];
     //History heuristics are a more general approach to move ordering based on the historical performance of moves. Every time a move causes a beta-cutoff, its "history score" is increased. 
 	//The history score is indexed by the from-square and to-square of the move, regardless of which piece is moving. 
 	int searchHistory[13][BRD_SQ_NUM];
+	//Capture history plays the same role for captures, indexed by the moving piece, the target square and the captured piece.
+	//It is used to break ties inside the MVV-LVA ordering.
+	int captureHistory[13][BRD_SQ_NUM][13];
 	//Search killers refer to moves that have caused a beta-cutoff in sibling nodes at the same depth of the search tree but are not captures or promotions (typically quiet moves). 
 	//The idea is that if a non-capturing move in one part of the tree at a certain depth causes a cutoff, the same move might be strong in a different part of the tree at the same depth. There are usually two slots for killer moves at each depth: the primary and the secondary killer. When a new killer move is found, it replaces the older one, and the older one moves to the secondary slot.
 	//
 	int searchKillers[2][MAXDEPTH];
 
 } S_BOARD;
+
+typedef int (*S_ENDGAMEEVAL)(const S_BOARD *pos, const int strongSide);//white relative
+
+typedef struct {//what the eval knows from the piece counts alone
+	U64 materialKey;
+	int imbalance;//packed, white minus black
+	int phase;//PHASE_TOTAL at the start and 0 with only pawns
+	int scale[2];//out of SCALE_NORMAL, applied when that side is ahead
+	S_ENDGAMEEVAL evaluate;//a specialised evaluator for this material, or NULL
+	int strongSide;//the side the evaluator plays for
+} S_MATERIALENTRY;
+
+struct S_MATERIALTABLE {
+	S_MATERIALENTRY entry[MATERIAL_HASH_ENTRIES];
+	long hit;
+	long miss;
+};
 //It is designed to hold various parameters and statistics related to the search process in a chess engine, especially one that communicates using the Universal Chess Interface (UCI) protocol. 
 //The UCI protocol is a standard for chess engines to communicate with chess GUIs.
 typedef struct {
     //these are used in UCI protocol
-	int starttime;//the start time of the search . This is likely recorded to manage time control and ensure the engine makes a move within the allocated time
-	int stoptime;//the stop time of the search , either because the engine has found a satisfactory move or because it's running out of allocated time.
+	long long starttime;//the start time of the search . This is likely recorded to manage time control and ensure the engine makes a move within the allocated time
+	long long stoptime;//the stop time of the search , either because the engine has found a satisfactory move or because it's running out of allocated time.
 	int depth;//the depth of the search This represents how many moves ahead the engine will evaluate. Deeper searches result in stronger play but require more computation.
 	int timeset;//the time set for the search
 	int movestogo;// The number of moves to go until the next time control. In tournaments, games often have multiple time controls, such as "40 moves in 2 hours."
+	long long optimumTime;//soft limit in ms, no new iteration is started past it (scaled by how settled the search is)
+	long long maximumTime;//hard limit in ms, stoptime is starttime plus this and the timer thread enforces it
+	int fixedTime;//movetime searches spend their whole time instead of stopping early
+
+	S_ROOTMOVE rootMoves[MAXPOSITIONMOVES];//the legal root moves, best first after every iteration
+	int rootCount;
+	int searchMoves[MAXPOSITIONMOVES];//go searchmoves, only these root moves are searched (none given means all)
+	int searchMovesCount;
+
+	int lastBestMove;//best move, score and for how many iterations the best move has not changed,
+	int lastScore;//used by the time manager to decide whether another iteration is worth starting
+	int bestMoveStable;
 
 	long nodes;//A long integer representing the number of positions (nodes) the engine has evaluated during the search
+	long nodeLimit;//go nodes, the search stops after exactly this many nodes (0 for no limit)
+	int nodesTime;//nodes per ms when the clock is counted in nodes (nodestime), 0 to use the wall clock
 
 	int quit;//this is used to quit the search if the quit command is given in UCI
-	int stopped;//this is used to stop the search if the stop command is given in UCI
+	atomic_int stopped;//this is used to stop the search if the stop command is given in UCI, or by the timer thread when time is up
+	atomic_int ponder;//searching on the opponent's time, the clock is not running and no move may be played until ponderhit or stop
+	int ponderMove;//the expected reply, the second move of the PV of the last completed iteration
 
 	float fh;
 	float fhf;
@@ -161,6 +286,12 @@ typedef struct {
 
 typedef struct {
 	int UseBook;
+	int Ponder;
+	int MoveOverhead;//ms kept back on every move for the GUI and network lag
+	int MultiPV;//number of best lines searched and reported
+	int NodesTime;//nodes per ms, when set the clock is measured in searched nodes so games replay exactly
+	int LazyMargin;//lazy eval returns early when the estimate is this far outside the window, 0 turns it off
+	int LazyCheck;//also run the full eval after each early exit and count the ones it gets wrong
 } S_OPTIONS;
 
 
@@ -208,6 +339,10 @@ typedef struct {
 
 #define MIRROR64(sq) (Mirror64[(sq)])
 
+// the hash keys are built by OR-ing rand() values so their bits are biased, mix them before taking 13 bits
+#define CUCKOO_H1(key) ((int)(((key) * 0x9E3779B97F4A7C15ULL) >> 51))
+#define CUCKOO_H2(key) ((int)(((key) * 0xC2B2AE3D27D4EB4FULL) >> 51))
+
 /* GLOBALS */
 
 extern int Sq120ToSq64[BRD_SQ_NUM];
@@ -217,6 +352,8 @@ extern U64 ClearMask[64];
 extern U64 PieceKeys[13][120];
 extern U64 SideKey;
 extern U64 CastleKeys[16];
+extern U64 CuckooKeys[8192];
+extern int CuckooMoves[8192];
 extern char PceChar[];
 extern char SideChar[];
 extern char RankChar[];
@@ -226,6 +363,7 @@ extern int PieceBig[13];
 extern int PieceMaj[13];
 extern int PieceMin[13];
 extern int PieceVal[13];
+extern int PiecePhase[13];
 extern int PieceCol[13];
 extern int PiecePawn[13];
 
@@ -238,6 +376,9 @@ extern int PieceRookQueen[13];
 extern int PieceBishopQueen[13];
 extern int PieceSlides[13];
 
+extern const int PceDir[13][8];
+extern const int NumDir[13];
+
 extern int Mirror64[64];
 
 extern U64 FileBBMask[8];
@@ -261,6 +402,9 @@ extern int CountBits(U64 b);
 
 // hashkeys.c
 extern U64 GeneratePosKey(const S_BOARD *pos);
+extern U64 GeneratePawnKey(const S_BOARD *pos);
+extern U64 GenerateMaterialKey(const S_BOARD *pos);
+extern U64 ZobristFingerprint();
 
 // board.c
 extern void ResetBoard(S_BOARD *pos);
@@ -291,6 +435,7 @@ extern int SqIs120(const int sq);
 extern int PceValidEmptyOffbrd(const int pce);
 extern int MoveListOk(const S_MOVELIST *list,  const S_BOARD *pos);
 extern void DebugAnalysisTest(S_BOARD *pos, S_SEARCHINFO *info);
+extern void Bench(S_BOARD *pos, S_SEARCHINFO *info, const int depth);
 
 // movegen.c
 extern void GenerateAllMoves(const S_BOARD *pos, S_MOVELIST *list);
@@ -300,6 +445,7 @@ extern void InitMvvLva();
 
 // makemove.c
 extern int MakeMove(S_BOARD *pos, int move);
+extern U64 KeyAfterMove(const S_BOARD *pos, const int move);
 extern void TakeMove(S_BOARD *pos);
 extern void MakeNullMove(S_BOARD *pos);
 extern void TakeNullMove(S_BOARD *pos);
@@ -309,23 +455,69 @@ extern void PerftTest(int depth, S_BOARD *pos);
 
 // search.c
 extern void SearchPosition(S_BOARD *pos, S_SEARCHINFO *info);
+extern void ClearSearchHistory(S_BOARD *pos);
 
 // misc.c
-extern int GetTimeMs();
+extern long long GetTimeMs();
 extern void ReadInput(S_SEARCHINFO *info);
+extern char *ReadInputLine(char *line, const int size);
+extern void SleepMs(const int ms);
+extern void StartSearchTimer(S_SEARCHINFO *info);
+extern void StopSearchTimer();
+extern void *AllocLargeMemory(const U64 size);
+extern void FreeLargeMemory(void *mem, const U64 size);
+extern void ClearLargeMemory(void *mem, const U64 size);
+extern void *AllocTable(const size_t size, const char *name);
+extern void *MapFile(const char *name, U64 *size);
+extern void UnmapFile(void *mem, const U64 size);
+
+// timeman.c
+extern void SetTimeLimits(S_SEARCHINFO *info, const int time, const int inc, const int movestogo, const int movetime);
+extern int StopAfterIteration(S_SEARCHINFO *info, const int bestMove, const int bestScore, const long long iterationTime);
+extern long long ElapsedTime(const S_SEARCHINFO *info);
 
 // pvtable.c
 extern void InitHashTable(S_HASHTABLE *table, const int MB);
-extern void StoreHashEntry(S_BOARD *pos, const int move, int score, const int flags, const int depth);
-extern int ProbeHashEntry(S_BOARD *pos, int *move, int *score, int alpha, int beta, int depth);
+extern void ResizeHashTable(S_HASHTABLE *table, const int MB);
+extern void StartHashResize(S_HASHTABLE *table, const int MB);
+extern void StartHashClear(S_HASHTABLE *table);
+extern void WaitForHashJob();
+extern void FreeHashTable(S_HASHTABLE *table);
+extern void NewSearchHashTable(S_HASHTABLE *table);
+extern int HashFull(const S_HASHTABLE *table);
+extern void PrefetchHashEntry(const S_HASHTABLE *table, const U64 posKey);
+extern void AddHashStats(S_HASHSTATS *total, const S_HASHSTATS *stats);
+extern void StoreHashEntry(S_BOARD *pos, const int move, int score, const int eval, const int flags, const int depth);
+extern int ProbeHashEntry(S_BOARD *pos, int *move, int *score, int *eval, int alpha, int beta, int depth);
 extern int ProbePvMove(const S_BOARD *pos);
-extern int GetPvLine(const int depth, S_BOARD *pos);
 extern void ClearHashTable(S_HASHTABLE *table);
+extern int SaveHashTable(const S_HASHTABLE *table, const char *name);
+extern int LoadHashTable(S_HASHTABLE *table, const char *name);
 
 // evaluate.c
+extern int PieceSquare[13][BRD_SQ_NUM];
+extern void InitPieceSquare();
 extern int EvalPosition(const S_BOARD *pos);
+extern int EvalPositionLazy(S_BOARD *pos, const int alpha, const int beta, int *lazy);
+extern void AddEvalStats(S_EVALSTATS *total, const S_EVALSTATS *stats);
 extern void MirrorEvalTest(S_BOARD *pos) ;
 
+// pawns.c
+extern S_PAWNTABLE *NewPawnTable();
+extern void FreePawnTable(S_PAWNTABLE *table);
+extern void ClearPawnTable(S_PAWNTABLE *table);
+extern const S_PAWNENTRY *ProbePawnTable(const S_BOARD *pos);
+
+// material.c
+extern S_MATERIALTABLE *NewMaterialTable();
+extern void FreeMaterialTable(S_MATERIALTABLE *table);
+extern void ClearMaterialTable(S_MATERIALTABLE *table);
+extern const S_MATERIALENTRY *ProbeMaterialTable(const S_BOARD *pos);
+
+// endgame.c
+extern void InitKPK();
+extern void FindEndgame(const S_BOARD *pos, S_MATERIALENTRY *entry);
+
 // uci.c
 extern void Uci_Loop(S_BOARD *pos, S_SEARCHINFO *info);
 
@@ -0,0 +1,290 @@
+// endgame.c
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "defs.h"
+
+// Endgames the general eval gets wrong or plays aimlessly. FindEndgame picks an evaluator
+// from the piece counts once per material key, the evaluators then score the position
+// for the strong side and return it white relative like the rest of the eval.
+
+#define KPK_SIZE (64 * 64 * 2 * 24) //white king, black king, side to move, pawn on a2-d7
+
+enum { KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4 };
+
+static unsigned int KPKBitbase[KPK_SIZE / 32];//one bit per position, set when white wins
+static U64 KingAttacks64[64];
+
+static int Distance(const int sq1, const int sq2) {
+	int files = abs(FilesBrd[sq1] - FilesBrd[sq2]);
+	int ranks = abs(RanksBrd[sq1] - RanksBrd[sq2]);
+	return files > ranks ? files : ranks;
+}
+
+// PushToEdge grows as the king gets away from the centre, the corners score most
+static int PushToEdge(const int sq) {
+	int file = FilesBrd[sq] < FILE_E ? FILE_D - FilesBrd[sq] : FilesBrd[sq] - FILE_E;
+	int rank = RanksBrd[sq] < RANK_5 ? RANK_4 - RanksBrd[sq] : RanksBrd[sq] - RANK_5;
+	return (file + rank) * 15;
+}
+
+static int PushClose(const int sq1, const int sq2) {
+	return 140 - 20 * Distance(sq1, sq2);
+}
+
+static int NonPawnMaterial(const S_BOARD *pos, const int side) {
+	return pos->material[side] - PieceVal[side == WHITE ? wK : bK] - pos->pceNum[side == WHITE ? wP : bP] * PieceVal[wP];
+}
+
+// BishopsOnBothColours: bishops of one colour only, as after an underpromotion, cannot mate
+static int BishopsOnBothColours(const S_BOARD *pos, const int side) {
+
+	int pce = side == WHITE ? wB : bB;
+	int pceNum;
+	int colours = 0;
+
+	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
+		colours |= 1 << ((FilesBrd[pos->pList[pce][pceNum]] + RanksBrd[pos->pList[pce][pceNum]]) % 2);
+	}
+	return colours == 3;
+}
+
+// BareKingStalemated: the lone king is to move, not in check and every square next to it is
+// attacked. The search only sees that with a move to go, the eval has to see it at the leaves.
+static int BareKingStalemated(const S_BOARD *pos, const int strongSide) {
+
+	int weakKing = pos->KingSq[strongSide ^ 1];
+	int index;
+	int sq;
+
+	if(pos->side == strongSide || SqAttacked(weakKing, strongSide, pos)) {
+		return FALSE;
+	}
+	for(index = 0; index < NumDir[wK]; ++index) {
+		sq = weakKing + PceDir[wK][index];
+		if(pos->pieces[sq] != OFFBOARD && !SqAttacked(sq, strongSide, pos)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// EvalKXK: the strong side has mating material against a bare king, drive the king to the
+// edge and bring our own one closer, the search finds the mate from there.
+// Bishops of one colour only win if a pawn gets through, they get no bonus.
+static int EvalKXK(const S_BOARD *pos, const int strongSide) {
+
+	int weakKing = pos->KingSq[strongSide ^ 1];
+	int score = pos->material[strongSide] - PieceVal[wK];
+
+	if(BareKingStalemated(pos, strongSide)) {
+		return 0;
+	}
+	if(pos->pceNum[strongSide == WHITE ? wQ : bQ] > 0 || pos->pceNum[strongSide == WHITE ? wR : bR] > 0
+		|| pos->pceNum[strongSide == WHITE ? wN : bN] > 0 || BishopsOnBothColours(pos, strongSide)) {
+		score += KNOWN_WIN;
+	} else if(pos->pceNum[strongSide == WHITE ? wP : bP] == 0) {
+		return 0;
+	}
+
+	score += PushToEdge(weakKing) + PushClose(pos->KingSq[strongSide], weakKing);
+	return strongSide == WHITE ? score : -score;
+}
+
+// EvalKBNK: the mate only works in a corner of the bishop's colour, drive the king there
+static int EvalKBNK(const S_BOARD *pos, const int strongSide) {
+
+	int weakKing = pos->KingSq[strongSide ^ 1];
+	int bishop = pos->pList[strongSide == WHITE ? wB : bB][0];
+	int file = FilesBrd[weakKing];
+	int rank = RanksBrd[weakKing];
+	int corner;
+	int score;
+
+	// how far the king is from the long diagonal of the other colour, 7 in the right corners
+	if((FilesBrd[bishop] + RanksBrd[bishop]) % 2 == 0) {// dark squared, a1 and h8
+		corner = abs(7 - file - rank);
+	} else {// light squared, a8 and h1
+		corner = abs(file - rank);
+	}
+
+	score = KNOWN_WIN + PieceVal[wB] + PieceVal[wN];
+	score += PushClose(pos->KingSq[strongSide], weakKing) + corner * 100;
+	return strongSide == WHITE ? score : -score;
+}
+
+static int KPKIndex(const int stm, const int wk, const int bk, const int pawn) {
+	return wk | (bk << 6) | (stm << 12) | ((pawn % 8) << 13) | ((6 - pawn / 8) << 15);
+}
+
+static int KPKProbe(const int stm, const int wk, const int bk, const int pawn) {
+	int index = KPKIndex(stm, wk, bk, pawn);
+	return (KPKBitbase[index >> 5] >> (index & 31)) & 1;
+}
+
+// EvalKPK looks the position up in the bitbase after turning it round so that white has the
+// pawn and the pawn stands on the queen side, a won position is scored well above the material
+static int EvalKPK(const S_BOARD *pos, const int strongSide) {
+
+	int wk = SQ64(pos->KingSq[strongSide]);
+	int bk = SQ64(pos->KingSq[strongSide ^ 1]);
+	int pawn = SQ64(pos->pList[strongSide == WHITE ? wP : bP][0]);
+	int stm = pos->side == strongSide ? WHITE : BLACK;
+	int score;
+
+	if(strongSide == BLACK) {
+		wk ^= 56;
+		bk ^= 56;
+		pawn ^= 56;
+	}
+	if(pawn % 8 > FILE_D) {
+		wk ^= 7;
+		bk ^= 7;
+		pawn ^= 7;
+	}
+
+	if(!KPKProbe(stm, wk, bk, pawn)) {
+		return 0;
+	}
+	score = KNOWN_WIN + PieceVal[wP] + pawn / 8 * 10;
+	return strongSide == WHITE ? score : -score;
+}
+
+static U64 PawnAttacks64(const int sq) {
+	U64 attacks = 0ULL;
+	if(sq % 8 > FILE_A) attacks |= 1ULL << (sq + 7);
+	if(sq % 8 < FILE_H) attacks |= 1ULL << (sq + 9);
+	return attacks;
+}
+
+static int Distance64(const int sq1, const int sq2) {
+	int files = abs(sq1 % 8 - sq2 % 8);
+	int ranks = abs(sq1 / 8 - sq2 / 8);
+	return files > ranks ? files : ranks;
+}
+
+// KPKInitial classifies what is known without looking ahead: illegal positions, a pawn that
+// promotes safely at once, a stalemate and a pawn black takes for free
+static unsigned char KPKInitial(const int index) {
+
+	int wk = index & 63;
+	int bk = (index >> 6) & 63;
+	int stm = (index >> 12) & 1;
+	int pawn = ((index >> 13) & 3) + 8 * (6 - (index >> 15));
+
+	if(Distance64(wk, bk) <= 1 || wk == pawn || bk == pawn || (stm == WHITE && (PawnAttacks64(pawn) & (1ULL << bk)))) {
+		return KPK_INVALID;
+	}
+	if(stm == WHITE && pawn / 8 == RANK_7 && wk != pawn + 8 && (Distance64(bk, pawn + 8) > 1 || Distance64(wk, pawn + 8) == 1)) {
+		return KPK_WIN;
+	}
+	if(stm == BLACK && (!(KingAttacks64[bk] & ~(KingAttacks64[wk] | PawnAttacks64(pawn)))
+		|| (KingAttacks64[bk] & ~KingAttacks64[wk] & (1ULL << pawn)))) {
+		return KPK_DRAW;
+	}
+	return KPK_UNKNOWN;
+}
+
+// KPKClassify looks one move ahead, white wants a move to a win and black one to a draw
+static unsigned char KPKClassify(const unsigned char *db, const int index) {
+
+	int wk = index & 63;
+	int bk = (index >> 6) & 63;
+	int stm = (index >> 12) & 1;
+	int pawn = ((index >> 13) & 3) + 8 * (6 - (index >> 15));
+	int good = stm == WHITE ? KPK_WIN : KPK_DRAW;
+	int bad = stm == WHITE ? KPK_DRAW : KPK_WIN;
+	int result = KPK_INVALID;
+	int sq;
+
+	for(sq = 0; sq < 64; ++sq) {
+		if(KingAttacks64[stm == WHITE ? wk : bk] & (1ULL << sq)) {
+			result |= db[stm == WHITE ? KPKIndex(BLACK, sq, bk, pawn) : KPKIndex(WHITE, wk, sq, pawn)];
+		}
+	}
+
+	if(stm == WHITE) {
+		if(pawn / 8 < RANK_7) {
+			result |= db[KPKIndex(BLACK, wk, bk, pawn + 8)];
+		}
+		if(pawn / 8 == RANK_2 && pawn + 8 != wk && pawn + 8 != bk) {
+			result |= db[KPKIndex(BLACK, wk, bk, pawn + 16)];
+		}
+	}
+
+	return result & good ? good : result & KPK_UNKNOWN ? KPK_UNKNOWN : bad;
+}
+
+// InitKPK works out every king and pawn against king position by going over the unknown ones
+// until nothing changes and keeps one bit per position
+void InitKPK() {
+
+	static unsigned char db[KPK_SIZE];
+	int index;
+	int sq, to;
+	int changed = TRUE;
+
+	for(sq = 0; sq < 64; ++sq) {
+		KingAttacks64[sq] = 0ULL;
+		for(to = 0; to < 64; ++to) {
+			if(to != sq && Distance64(sq, to) == 1) {
+				KingAttacks64[sq] |= 1ULL << to;
+			}
+		}
+	}
+
+	for(index = 0; index < KPK_SIZE; ++index) {
+		db[index] = KPKInitial(index);
+	}
+
+	while(changed == TRUE) {
+		changed = FALSE;
+		for(index = 0; index < KPK_SIZE; ++index) {
+			if(db[index] == KPK_UNKNOWN) {
+				db[index] = KPKClassify(db, index);
+				if(db[index] != KPK_UNKNOWN) changed = TRUE;
+			}
+		}
+	}
+
+	for(index = 0; index < KPK_SIZE / 32; ++index) {
+		KPKBitbase[index] = 0;
+	}
+	for(index = 0; index < KPK_SIZE; ++index) {
+		if(db[index] == KPK_WIN) {
+			KPKBitbase[index >> 5] |= 1u << (index & 31);
+		}
+	}
+}
+
+// FindEndgame sets the evaluator of the entry when one side has a bare king against
+// material that has a specialised evaluator
+void FindEndgame(const S_BOARD *pos, S_MATERIALENTRY *entry) {
+
+	int side;
+	int weak;
+	int pawns, knights, bishops, rooks, queens;
+
+	for(side = WHITE; side <= BLACK; ++side) {
+		weak = side ^ 1;
+		if(pos->material[weak] != PieceVal[wK]) {
+			continue;
+		}
+
+		pawns = pos->pceNum[side == WHITE ? wP : bP];
+		knights = pos->pceNum[side == WHITE ? wN : bN];
+		bishops = pos->pceNum[side == WHITE ? wB : bB];
+		rooks = pos->pceNum[side == WHITE ? wR : bR];
+		queens = pos->pceNum[side == WHITE ? wQ : bQ];
+
+		entry->strongSide = side;
+		if(pawns == 0 && knights == 1 && bishops == 1 && rooks == 0 && queens == 0) {
+			entry->evaluate = EvalKBNK;
+		} else if(queens > 0 || rooks > 0 || bishops >= 2 || (bishops > 0 && knights > 0)) {
+			entry->evaluate = EvalKXK;
+		} else if(pawns == 1 && NonPawnMaterial(pos, side) == 0) {
+			entry->evaluate = EvalKPK;
+		}
+		return;
+	}
+}
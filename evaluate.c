@@ -3,13 +3,11 @@
 #include "stdio.h"
 #include "defs.h"
 
-const int PawnIsolated = -10;
-const int PawnPassed[8] = { 0, 5, 10, 20, 35, 60, 100, 200 }; 
-const int RookOpenFile = 10;
-const int RookSemiOpenFile = 5;
-const int QueenOpenFile = 5;
-const int QueenSemiOpenFile = 3;
-const int BishopPair = 30;
+// the terms are packed middlegame and endgame values, see S() in defs.h
+const int RookOpenFile = S(10, 10);
+const int RookSemiOpenFile = S(5, 5);
+const int QueenOpenFile = S(5, 5);
+const int QueenSemiOpenFile = S(3, 3);
 
 const int PawnTable[64] = {
 0	,	0	,	0	,	0	,	0	,	0	,	0	,	0	,
@@ -76,128 +74,100 @@ const int KingO[64] = {
 	-70	,	-70	,	-70	,	-70	,	-70	,	-70	,	-70	,	-70	,
 	-70	,	-70	,	-70	,	-70	,	-70	,	-70	,	-70	,	-70		
 };
-// sjeng 11.2
-//8/6R1/2k5/6P1/8/8/4nP2/6K1 w - - 1 41 
-int MaterialDraw(const S_BOARD *pos) {
-
-	ASSERT(CheckBoard(pos));
-	
-    if (!pos->pceNum[wR] && !pos->pceNum[bR] && !pos->pceNum[wQ] && !pos->pceNum[bQ]) {
-	  if (!pos->pceNum[bB] && !pos->pceNum[wB]) {
-	      if (pos->pceNum[wN] < 3 && pos->pceNum[bN] < 3) {  return TRUE; }
-	  } else if (!pos->pceNum[wN] && !pos->pceNum[bN]) {
-	     if (abs(pos->pceNum[wB] - pos->pceNum[bB]) < 2) { return TRUE; }
-	  } else if ((pos->pceNum[wN] < 3 && !pos->pceNum[wB]) || (pos->pceNum[wB] == 1 && !pos->pceNum[wN])) {
-	    if ((pos->pceNum[bN] < 3 && !pos->pceNum[bB]) || (pos->pceNum[bB] == 1 && !pos->pceNum[bN]))  { return TRUE; }
-	  }
-	} else if (!pos->pceNum[wQ] && !pos->pceNum[bQ]) {
-        if (pos->pceNum[wR] == 1 && pos->pceNum[bR] == 1) {
-            if ((pos->pceNum[wN] + pos->pceNum[wB]) < 2 && (pos->pceNum[bN] + pos->pceNum[bB]) < 2)	{ return TRUE; }
-        } else if (pos->pceNum[wR] == 1 && !pos->pceNum[bR]) {
-            if ((pos->pceNum[wN] + pos->pceNum[wB] == 0) && (((pos->pceNum[bN] + pos->pceNum[bB]) == 1) || ((pos->pceNum[bN] + pos->pceNum[bB]) == 2))) { return TRUE; }
-        } else if (pos->pceNum[bR] == 1 && !pos->pceNum[wR]) {
-            if ((pos->pceNum[bN] + pos->pceNum[bB] == 0) && (((pos->pceNum[wN] + pos->pceNum[wB]) == 1) || ((pos->pceNum[wN] + pos->pceNum[wB]) == 2))) { return TRUE; }
-        }
-    }
-  return FALSE;
+// The packed piece-square value of every piece on every square, black's mirrored and negated
+// so that one sum over the board is white's score. The board keeps that sum up to date as
+// pieces move, so the evaluation does not have to look at each piece for it.
+// Only the king has a different table for the endgame.
+int PieceSquare[13][BRD_SQ_NUM];
+
+void InitPieceSquare() {
+
+	int sq64 = 0;
+	int sq = 0;
+	int white = 0;
+	int black = 0;
+
+	for(sq64 = 0; sq64 < 64; ++sq64) {
+		sq = SQ120(sq64);
+		white = sq64;
+		black = MIRROR64(sq64);
+		PieceSquare[wP][sq] = S(PawnTable[white], PawnTable[white]);
+		PieceSquare[bP][sq] = -S(PawnTable[black], PawnTable[black]);
+		PieceSquare[wN][sq] = S(KnightTable[white], KnightTable[white]);
+		PieceSquare[bN][sq] = -S(KnightTable[black], KnightTable[black]);
+		PieceSquare[wB][sq] = S(BishopTable[white], BishopTable[white]);
+		PieceSquare[bB][sq] = -S(BishopTable[black], BishopTable[black]);
+		PieceSquare[wR][sq] = S(RookTable[white], RookTable[white]);
+		PieceSquare[bR][sq] = -S(RookTable[black], RookTable[black]);
+		PieceSquare[wK][sq] = S(KingO[white], KingE[white]);
+		PieceSquare[bK][sq] = -S(KingO[black], KingE[black]);
+	}
 }
 
-#define ENDGAME_MAT (1 * PieceVal[wR] + 2 * PieceVal[wN] + 2 * PieceVal[wP] + PieceVal[wK])
+// Blend turns the packed terms into one white relative score for the material of the position
+static int Blend(const S_BOARD *pos, const S_MATERIALENTRY *material, const int packed) {
 
-int EvalPosition(const S_BOARD *pos) {
+	int score = (MG_SCORE(packed) * material->phase + EG_SCORE(packed) * (PHASE_TOTAL - material->phase)) / PHASE_TOTAL;
+
+	score += pos->material[WHITE] - pos->material[BLACK];
+	return score * material->scale[score > 0 ? WHITE : BLACK] / SCALE_NORMAL;
+}
+
+// EvalFull adds up the packed terms and blends the middlegame and endgame halves by
+// the phase, so the evaluation moves smoothly from one to the other as pieces come off.
+// The material table can hand the position to an endgame evaluator or scale it towards a draw.
+// With a window, a position whose material and piece-square score is already more than the
+// lazy margin outside it is returned from that estimate and *lazy is set.
+static int EvalFull(const S_BOARD *pos, const int alpha, const int beta, int *lazy) {
 
 	ASSERT(CheckBoard(pos));
 
 	int pce;
 	int pceNum;
 	int sq;
-	int score = pos->material[WHITE] - pos->material[BLACK];
-	
-	if(!pos->pceNum[wP] && !pos->pceNum[bP] && MaterialDraw(pos) == TRUE) {
+	int score = pos->psq;
+	int openFiles;
+	int margin = EngineOptions->LazyMargin;
+	int estimate;
+	const S_PAWNENTRY *pawns;
+	const S_MATERIALENTRY *material = ProbeMaterialTable(pos);
+
+	*lazy = FALSE;
+
+	if(material->evaluate != NULL) {
+		score = material->evaluate(pos, material->strongSide);
+		return pos->side == WHITE ? score : -score;
+	}
+	if(material->scale[WHITE] == 0 && material->scale[BLACK] == 0) {
 		return 0;
 	}
-	
-	pce = wP;	
-	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-		sq = pos->pList[pce][pceNum];
-		ASSERT(SqOnBoard(sq));
-		ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
-		score += PawnTable[SQ64(sq)];	
-		
-		if( (IsolatedMask[SQ64(sq)] & pos->pawns[WHITE]) == 0) {
-			//printf("wP Iso:%s\n",PrSq(sq));
-			score += PawnIsolated;
-		}
-		
-		if( (WhitePassedMask[SQ64(sq)] & pos->pawns[BLACK]) == 0) {
-			//printf("wP Passed:%s\n",PrSq(sq));
-			score += PawnPassed[RanksBrd[sq]];
-		}
-		
-	}	
 
-	pce = bP;	
-	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-		sq = pos->pList[pce][pceNum];
-		ASSERT(SqOnBoard(sq));
-		ASSERT(MIRROR64(SQ64(sq))>=0 && MIRROR64(SQ64(sq))<=63);
-		score -= PawnTable[MIRROR64(SQ64(sq))];	
-		
-		if( (IsolatedMask[SQ64(sq)] & pos->pawns[BLACK]) == 0) {
-			//printf("bP Iso:%s\n",PrSq(sq));
-			score -= PawnIsolated;
-		}
-		
-		if( (BlackPassedMask[SQ64(sq)] & pos->pawns[WHITE]) == 0) {
-			//printf("bP Passed:%s\n",PrSq(sq));
-			score -= PawnPassed[7 - RanksBrd[sq]];
-		}
-	}	
-	
-	pce = wN;	
-	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-		sq = pos->pList[pce][pceNum];
-		ASSERT(SqOnBoard(sq));
-		ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
-		score += KnightTable[SQ64(sq)];
-	}	
+	score += material->imbalance;
 
-	pce = bN;	
-	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-		sq = pos->pList[pce][pceNum];
-		ASSERT(SqOnBoard(sq));
-		ASSERT(MIRROR64(SQ64(sq))>=0 && MIRROR64(SQ64(sq))<=63);
-		score -= KnightTable[MIRROR64(SQ64(sq))];
-	}			
-	
-	pce = wB;	
-	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-		sq = pos->pList[pce][pceNum];
-		ASSERT(SqOnBoard(sq));
-		ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
-		score += BishopTable[SQ64(sq)];
-	}	
+	if(margin > 0 && (alpha > -INFINITE || beta < INFINITE)) {
+		estimate = Blend(pos, material, score);
+		if(pos->side == BLACK) estimate = -estimate;
+		if(estimate - margin >= beta || estimate + margin <= alpha) {
+			*lazy = TRUE;
+			return estimate;
+		}
+	}
 
-	pce = bB;	
-	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-		sq = pos->pList[pce][pceNum];
-		ASSERT(SqOnBoard(sq));
-		ASSERT(MIRROR64(SQ64(sq))>=0 && MIRROR64(SQ64(sq))<=63);
-		score -= BishopTable[MIRROR64(SQ64(sq))];
-	}	
+	pawns = ProbePawnTable(pos);
+	score += pawns->score;
+	openFiles = pawns->semiOpen[WHITE] & pawns->semiOpen[BLACK];
 
 	pce = wR;	
 	for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
 		sq = pos->pList[pce][pceNum];
 		ASSERT(SqOnBoard(sq));
 		ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
-		score += RookTable[SQ64(sq)];
 		
 		ASSERT(FileRankValid(FilesBrd[sq]));
 		
-		if(!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]])) {
+		if(openFiles & (1 << FilesBrd[sq])) {
 			score += RookOpenFile;
-		} else if(!(pos->pawns[WHITE] & FileBBMask[FilesBrd[sq]])) {
+		} else if(pawns->semiOpen[WHITE] & (1 << FilesBrd[sq])) {
 			score += RookSemiOpenFile;
 		}
 	}	
@@ -207,11 +177,10 @@ int EvalPosition(const S_BOARD *pos) {
 		sq = pos->pList[pce][pceNum];
 		ASSERT(SqOnBoard(sq));
 		ASSERT(MIRROR64(SQ64(sq))>=0 && MIRROR64(SQ64(sq))<=63);
-		score -= RookTable[MIRROR64(SQ64(sq))];
 		ASSERT(FileRankValid(FilesBrd[sq]));
-		if(!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]])) {
+		if(openFiles & (1 << FilesBrd[sq])) {
 			score -= RookOpenFile;
-		} else if(!(pos->pawns[BLACK] & FileBBMask[FilesBrd[sq]])) {
+		} else if(pawns->semiOpen[BLACK] & (1 << FilesBrd[sq])) {
 			score -= RookSemiOpenFile;
 		}
 	}	
@@ -222,9 +191,9 @@ int EvalPosition(const S_BOARD *pos) {
 		ASSERT(SqOnBoard(sq));
 		ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
 		ASSERT(FileRankValid(FilesBrd[sq]));
-		if(!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]])) {
+		if(openFiles & (1 << FilesBrd[sq])) {
 			score += QueenOpenFile;
-		} else if(!(pos->pawns[WHITE] & FileBBMask[FilesBrd[sq]])) {
+		} else if(pawns->semiOpen[WHITE] & (1 << FilesBrd[sq])) {
 			score += QueenSemiOpenFile;
 		}
 	}	
@@ -235,38 +204,15 @@ int EvalPosition(const S_BOARD *pos) {
 		ASSERT(SqOnBoard(sq));
 		ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
 		ASSERT(FileRankValid(FilesBrd[sq]));
-		if(!(pos->pawns[BOTH] & FileBBMask[FilesBrd[sq]])) {
+		if(openFiles & (1 << FilesBrd[sq])) {
 			score -= QueenOpenFile;
-		} else if(!(pos->pawns[BLACK] & FileBBMask[FilesBrd[sq]])) {
+		} else if(pawns->semiOpen[BLACK] & (1 << FilesBrd[sq])) {
 			score -= QueenSemiOpenFile;
 		}
 	}	
-	//8/p6k/6p1/5p2/P4K2/8/5pB1/8 b - - 2 62 
-	pce = wK;
-	sq = pos->pList[pce][0];
-	ASSERT(SqOnBoard(sq));
-	ASSERT(SQ64(sq)>=0 && SQ64(sq)<=63);
-	
-	if( (pos->material[BLACK] <= ENDGAME_MAT) ) {
-		score += KingE[SQ64(sq)];
-	} else {
-		score += KingO[SQ64(sq)];
-	}
-	
-	pce = bK;
-	sq = pos->pList[pce][0];
-	ASSERT(SqOnBoard(sq));
-	ASSERT(MIRROR64(SQ64(sq))>=0 && MIRROR64(SQ64(sq))<=63);
-	
-	if( (pos->material[WHITE] <= ENDGAME_MAT) ) {
-		score -= KingE[MIRROR64(SQ64(sq))];
-	} else {
-		score -= KingO[MIRROR64(SQ64(sq))];
-	}
-	
-	if(pos->pceNum[wB] >= 2) score += BishopPair;
-	if(pos->pceNum[bB] >= 2) score -= BishopPair;
 	
+	score = Blend(pos, material, score);
+
 	if(pos->side == WHITE) {
 		return score;
 	} else {
@@ -274,20 +220,41 @@ int EvalPosition(const S_BOARD *pos) {
 	}	
 }
 
+// EvalPosition is the full evaluation from the side to move's point of view
+int EvalPosition(const S_BOARD *pos) {
 
+	int lazy;
 
+	return EvalFull(pos, -INFINITE, INFINITE, &lazy);
+}
 
+// EvalPositionLazy is EvalPosition for a search that only needs to know where the score stands
+// against alpha and beta. *lazy is set when the score is only an estimate. The search calls it
+// whenever the hash table had no eval, so it keeps the eval counts of the search as well.
+int EvalPositionLazy(S_BOARD *pos, const int alpha, const int beta, int *lazy) {
+
+	int score = EvalFull(pos, alpha, beta, lazy);
+	int full;
+
+	ASSERT(score > -INFINITE && score < INFINITE);
+	pos->evalStats.computed++;
+	if(*lazy == TRUE) {
+		pos->evalStats.lazy++;
+		if(EngineOptions->LazyCheck == TRUE) {//count the exits the full eval would have put on the other side of the window
+			full = EvalPosition(pos);
+			pos->evalStats.lazyChecked++;
+			if((score >= beta && full < beta) || (score <= alpha && full > alpha)) {
+				pos->evalStats.lazyWrong++;
+			}
+		}
+	}
+	return score;
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
+void AddEvalStats(S_EVALSTATS *total, const S_EVALSTATS *stats) {
+	total->hashEval += stats->hashEval;
+	total->computed += stats->computed;
+	total->lazy += stats->lazy;
+	total->lazyChecked += stats->lazyChecked;
+	total->lazyWrong += stats->lazyWrong;
+}
@@ -35,3 +35,52 @@ U64 GeneratePosKey(const S_BOARD *pos) {
 	return finalKey;
 }
 
+
+// GeneratePawnKey is the part of the position key made by the pawns, the pawn table is indexed by it
+U64 GeneratePawnKey(const S_BOARD *pos) {
+
+	int sq = 0;
+	U64 pawnKey = 0;
+
+	for(sq = 0; sq < BRD_SQ_NUM; ++sq) {
+		if(pos->pieces[sq] == wP || pos->pieces[sq] == bP) {
+			pawnKey ^= PieceKeys[pos->pieces[sq]][sq];
+		}
+	}
+	return pawnKey;
+}
+
+// GenerateMaterialKey hashes the piece counts, the n-th piece of a type adds PieceKeys[pce][n].
+// Those indexes are off board squares, so the keys are never used for anything else.
+U64 GenerateMaterialKey(const S_BOARD *pos) {
+
+	int pce = 0;
+	int count = 0;
+	U64 materialKey = 0;
+
+	for(pce = wP; pce <= bK; ++pce) {
+		for(count = 0; count < pos->pceNum[pce]; ++count) {
+			materialKey ^= PieceKeys[pce][count];
+		}
+	}
+	return materialKey;
+}
+
+// ZobristFingerprint folds every key into one number, a saved hash table is only
+// usable by a build whose random keys came out exactly the same
+U64 ZobristFingerprint() {
+
+	int index = 0;
+	int sq = 0;
+	U64 fingerprint = SideKey;
+
+	for(index = 0; index < 13; ++index) {
+		for(sq = 0; sq < BRD_SQ_NUM; ++sq) {
+			fingerprint = (fingerprint ^ PieceKeys[index][sq]) * 0x9E3779B97F4A7C15ULL;
+		}
+	}
+	for(index = 0; index < 16; ++index) {
+		fingerprint = (fingerprint ^ CastleKeys[index]) * 0x9E3779B97F4A7C15ULL;
+	}
+	return fingerprint;
+}
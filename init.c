@@ -20,6 +20,9 @@ U64 PieceKeys[13][120];
 U64 SideKey;
 U64 CastleKeys[16];
 
+U64 CuckooKeys[8192];
+int CuckooMoves[8192];
+
 int FilesBrd[BRD_SQ_NUM];
 int RanksBrd[BRD_SQ_NUM];
 
@@ -140,6 +143,74 @@ void InitHashKeys() {
 
 }
 
+static int PieceReaches(const int pce, const int from, const int to) {//can the piece go from -> to on an empty board
+
+	int index = 0;
+	int t_sq = 0;
+
+	for(index = 0; index < NumDir[pce]; ++index) {
+		t_sq = from + PceDir[pce][index];
+		while(FilesBrd[t_sq] != OFFBOARD) {
+			if(t_sq == to) {
+				return TRUE;
+			}
+			if(!PieceSlides[pce]) {
+				break;
+			}
+			t_sq += PceDir[pce][index];
+		}
+	}
+	return FALSE;
+}
+
+// Cuckoo tables for upcoming repetition detection (Marcel van Kervinck's method).
+// Every reversible piece move is stored by the key difference it makes, piece keys
+// of both squares plus the side key, so a single lookup tells whether two hash keys
+// are one move apart. There are 3668 such moves, they fit in 8192 slots with two hash functions.
+void InitCuckoo() {
+
+	int pce = EMPTY;
+	int sq1 = 0;
+	int sq2 = 0;
+	int slot = 0;
+	int move = NOMOVE;
+	int tempMove = NOMOVE;
+	int count = 0;
+	U64 key = 0ULL;
+	U64 tempKey = 0ULL;
+
+	for(slot = 0; slot < 8192; ++slot) {
+		CuckooKeys[slot] = 0ULL;
+		CuckooMoves[slot] = NOMOVE;
+	}
+
+	for(pce = wP; pce <= bK; ++pce) {
+		if(PiecePawn[pce]) {
+			continue;
+		}
+		for(sq1 = 0; sq1 < 64; ++sq1) {
+			for(sq2 = sq1 + 1; sq2 < 64; ++sq2) {
+				if(!PieceReaches(pce, SQ120(sq1), SQ120(sq2))) {
+					continue;
+				}
+				move = SQ120(sq1) | (SQ120(sq2) << 7);
+				key = PieceKeys[pce][SQ120(sq1)] ^ PieceKeys[pce][SQ120(sq2)] ^ SideKey;
+				slot = CUCKOO_H1(key);
+				while(TRUE) {//push out whatever is in the slot and send it to its other slot
+					tempKey = CuckooKeys[slot]; CuckooKeys[slot] = key; key = tempKey;
+					tempMove = CuckooMoves[slot]; CuckooMoves[slot] = move; move = tempMove;
+					if(move == NOMOVE) {
+						break;
+					}
+					slot = (slot == CUCKOO_H1(key)) ? CUCKOO_H2(key) : CUCKOO_H1(key);
+				}
+				count++;
+			}
+		}
+	}
+	ASSERT(count == 3668);
+}
+
 void InitBitMasks() {//this function initializes the bit masks
 	int index = 0;
 
@@ -186,6 +257,9 @@ void AllInit() {
 	InitHashKeys();
 	InitFilesRanksBrd();
 	InitEvalMasks();
+	InitPieceSquare();
+	InitKPK();
 	InitMvvLva();
+	InitCuckoo();
 	InitPolyBook();
 }
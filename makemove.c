@@ -42,6 +42,7 @@ static void ClearPiece(const int sq, S_BOARD *pos) {//this function clears a pie
 	
 	pos->pieces[sq] = EMPTY;//the square is now made empty
     pos->material[col] -= PieceVal[pce];//the material of the color is decreased by the value of the piece
+	pos->psq -= PieceSquare[pce][sq];
 	
 	if(PieceBig[pce]) {//if the piece is big
 			pos->bigPce[col]--;//the number of big pieces of the color is decreased
@@ -53,6 +54,7 @@ static void ClearPiece(const int sq, S_BOARD *pos) {//this function clears a pie
 	} else {//if the piece is pawn
 		CLRBIT(pos->pawns[col],SQ64(sq));//the pawn is cleared from the color's pawns
 		CLRBIT(pos->pawns[BOTH],SQ64(sq));//the pawn is cleared from both colors' pawns
+		pos->pawnKey ^= PieceKeys[pce][sq];
 	}
 	
 	for(index = 0; index < pos->pceNum[pce]; ++index) {//this loop goes through the every piece of a certain type
@@ -66,6 +68,7 @@ static void ClearPiece(const int sq, S_BOARD *pos) {//this function clears a pie
 	ASSERT(t_pceNum>=0&&t_pceNum<10);//this is a macro to check if the piece number is valid
 	
 	pos->pceNum[pce]--;//the number of pieces of that type is decreased
+	pos->materialKey ^= PieceKeys[pce][pos->pceNum[pce]];
 	
 	pos->pList[pce][t_pceNum] = pos->pList[pce][pos->pceNum[pce]];
   //the piece number is now the last piece number of that type
@@ -95,9 +98,12 @@ static void AddPiece(const int sq, S_BOARD *pos, const int pce) {//this function
 	} else {
 		SETBIT(pos->pawns[col],SQ64(sq));//the pawn is set to the color's pawns
 		SETBIT(pos->pawns[BOTH],SQ64(sq));//the pawn is set to both colors' pawns
+		pos->pawnKey ^= PieceKeys[pce][sq];
 	}
 	
 	pos->material[col] += PieceVal[pce];//the material of the color is increased by the value of the piece
+	pos->psq += PieceSquare[pce][sq];
+	pos->materialKey ^= PieceKeys[pce][pos->pceNum[pce]];
 	pos->pList[pce][pos->pceNum[pce]++] = sq;//set the last piece number of that type to the square as u add a piece
                     //last piece number of that type is increased by 1 for the next piece of that type
 }
@@ -122,12 +128,15 @@ static void MovePiece(const int from, const int to, S_BOARD *pos) {//this functi
 	
 	HASH_PCE(pce,to);//this is a macro that hashes the posKey with the combination piece and square
 	pos->pieces[to] = pce;//the piece is now on the square to
+
+	pos->psq += PieceSquare[pce][to] - PieceSquare[pce][from];
 	
 	if(!PieceBig[pce]) {//if the piece is not big then it is a pawn
 		CLRBIT(pos->pawns[col],SQ64(from));//the pawn is cleared from the color's pawns
 		CLRBIT(pos->pawns[BOTH],SQ64(from));//the pawn is cleared from both colors' pawns
 		SETBIT(pos->pawns[col],SQ64(to));//the pawn is set to the color's pawns
 		SETBIT(pos->pawns[BOTH],SQ64(to));//the pawn is set to both colors' pawns
+		pos->pawnKey ^= PieceKeys[pce][from] ^ PieceKeys[pce][to];
 	}    
 	
 	for(index = 0; index < pos->pceNum[pce]; ++index) {//this loop goes through the every piece of a certain type
@@ -142,6 +151,46 @@ static void MovePiece(const int from, const int to, S_BOARD *pos) {//this functi
 	ASSERT(t_PieceNum);//this is a macro to tell that u found the piece
 }
 
+// KeyAfterMove is the position key after move, worked out without touching the board
+// so the hash bucket of the child can be fetched before the move is made
+U64 KeyAfterMove(const S_BOARD *pos, const int move) {
+
+	int from = FROMSQ(move);
+	int to = TOSQ(move);
+	int piece = pos->pieces[from];
+	int captured = CAPTURED(move);
+	int promoted = PROMOTED(move);
+	U64 key = pos->posKey ^ SideKey;
+
+	key ^= PieceKeys[piece][from];
+	key ^= PieceKeys[promoted != EMPTY ? promoted : piece][to];
+	if(captured != EMPTY) {
+		key ^= PieceKeys[captured][to];
+	}
+
+	if(move & MFLAGEP) {
+		key ^= pos->side == WHITE ? PieceKeys[bP][to-10] : PieceKeys[wP][to+10];
+	} else if(move & MFLAGCA) {
+		switch(to) {
+			case C1: key ^= PieceKeys[wR][A1] ^ PieceKeys[wR][D1]; break;
+			case C8: key ^= PieceKeys[bR][A8] ^ PieceKeys[bR][D8]; break;
+			case G1: key ^= PieceKeys[wR][H1] ^ PieceKeys[wR][F1]; break;
+			case G8: key ^= PieceKeys[bR][H8] ^ PieceKeys[bR][F8]; break;
+			default: ASSERT(FALSE); break;
+		}
+	}
+
+	if(pos->enPas != NO_SQ) {
+		key ^= PieceKeys[EMPTY][pos->enPas];
+	}
+	if(move & MFLAGPS) {
+		key ^= PieceKeys[EMPTY][pos->side == WHITE ? from+10 : from-10];
+	}
+
+	key ^= CastleKeys[pos->castlePerm] ^ CastleKeys[pos->castlePerm & CastlePerm[from] & CastlePerm[to]];
+	return key;
+}
+
 int MakeMove(S_BOARD *pos, int move) {//this function makes a move
 
 	ASSERT(CheckBoard(pos));//this is a function that checks if the board is valid
@@ -149,6 +198,9 @@ int MakeMove(S_BOARD *pos, int move) {//this function makes a move
     int from = FROMSQ(move);//this is to get the from square of the move
     int to = TOSQ(move);//this is to get the to square of the move
     int side = pos->side;//this is the side to move
+	U64 nextKey = KeyAfterMove(pos, move);
+
+	PrefetchHashEntry(pos->HashTable, nextKey);//the child probes this bucket first thing, start loading it now
 	
 	ASSERT(SqOnBoard(from));//this is a macro that checks if the square is on the board
     ASSERT(SqOnBoard(to));//this is a macro that checks if the square is on the board
@@ -248,6 +300,7 @@ int MakeMove(S_BOARD *pos, int move) {//this function makes a move
     HASH_SIDE;//hash the side with the position key
 
     ASSERT(CheckBoard(pos));//this is a function that checks if the board is valid
+    ASSERT(pos->posKey == nextKey);
 	
 		
 	if(SqAttacked(pos->KingSq[side],pos->side,pos))  {//if the king square of the side is attacked
@@ -0,0 +1,124 @@
+// material.c
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "defs.h"
+
+// Everything the eval works out from the piece counts alone (the phase, the bishop pair,
+// drawish material and the endgames with an evaluator of their own) is kept per material
+// key, so a position pays for it only the first time its material turns up.
+
+const int BishopPair = S(30, 50);
+
+// sjeng 11.2
+//8/6R1/2k5/6P1/8/8/4nP2/6K1 w - - 1 41
+static int MaterialDraw(const S_BOARD *pos) {
+
+    if (!pos->pceNum[wR] && !pos->pceNum[bR] && !pos->pceNum[wQ] && !pos->pceNum[bQ]) {
+	  if (!pos->pceNum[bB] && !pos->pceNum[wB]) {
+	      if (pos->pceNum[wN] < 3 && pos->pceNum[bN] < 3) {  return TRUE; }
+	  } else if (!pos->pceNum[wN] && !pos->pceNum[bN]) {
+	     if (abs(pos->pceNum[wB] - pos->pceNum[bB]) < 2) { return TRUE; }
+	  } else if ((pos->pceNum[wN] < 3 && !pos->pceNum[wB]) || (pos->pceNum[wB] == 1 && !pos->pceNum[wN])) {
+	    if ((pos->pceNum[bN] < 3 && !pos->pceNum[bB]) || (pos->pceNum[bB] == 1 && !pos->pceNum[bN]))  { return TRUE; }
+	  }
+	} else if (!pos->pceNum[wQ] && !pos->pceNum[bQ]) {
+        if (pos->pceNum[wR] == 1 && pos->pceNum[bR] == 1) {
+            if ((pos->pceNum[wN] + pos->pceNum[wB]) < 2 && (pos->pceNum[bN] + pos->pceNum[bB]) < 2)	{ return TRUE; }
+        } else if (pos->pceNum[wR] == 1 && !pos->pceNum[bR]) {
+            if ((pos->pceNum[wN] + pos->pceNum[wB] == 0) && (((pos->pceNum[bN] + pos->pceNum[bB]) == 1) || ((pos->pceNum[bN] + pos->pceNum[bB]) == 2))) { return TRUE; }
+        } else if (pos->pceNum[bR] == 1 && !pos->pceNum[wR]) {
+            if ((pos->pceNum[bN] + pos->pceNum[bB] == 0) && (((pos->pceNum[wN] + pos->pceNum[wB]) == 1) || ((pos->pceNum[wN] + pos->pceNum[wB]) == 2))) { return TRUE; }
+        }
+    }
+  return FALSE;
+}
+
+void ClearMaterialTable(S_MATERIALTABLE *table) {
+
+	int index = 0;
+
+	for(index = 0; index < MATERIAL_HASH_ENTRIES; ++index) {
+		table->entry[index].materialKey = 0ULL;//no position has it, there are always two kings
+		table->entry[index].imbalance = 0;
+		table->entry[index].phase = 0;
+		table->entry[index].scale[WHITE] = SCALE_NORMAL;
+		table->entry[index].scale[BLACK] = SCALE_NORMAL;
+		table->entry[index].evaluate = NULL;
+		table->entry[index].strongSide = WHITE;
+	}
+	table->hit = 0;
+	table->miss = 0;
+}
+
+// NewMaterialTable: a game has a few hundred material signatures, collisions are rare
+S_MATERIALTABLE *NewMaterialTable() {
+
+	S_MATERIALTABLE *table = (S_MATERIALTABLE *) AllocTable(sizeof(S_MATERIALTABLE), "Material Table");
+
+	ClearMaterialTable(table);
+	return table;
+}
+
+void FreeMaterialTable(S_MATERIALTABLE *table) {
+	free(table);
+}
+
+static void EvalMaterial(const S_BOARD *pos, S_MATERIALENTRY *entry) {
+
+	int pce = 0;
+	int side = 0;
+	int phase = 0;
+	int nonPawn[2] = { 0, 0 };
+
+	entry->materialKey = pos->materialKey;
+	entry->imbalance = 0;
+	entry->scale[WHITE] = SCALE_NORMAL;
+	entry->scale[BLACK] = SCALE_NORMAL;
+	entry->evaluate = NULL;
+	entry->strongSide = WHITE;
+
+	for(pce = wP; pce <= bK; ++pce) {
+		phase += PiecePhase[pce] * pos->pceNum[pce];
+		if(PieceBig[pce] == TRUE && PieceKing[pce] == FALSE) {
+			nonPawn[PieceCol[pce]] += PieceVal[pce] * pos->pceNum[pce];
+		}
+	}
+	entry->phase = phase < PHASE_TOTAL ? phase : PHASE_TOTAL;//promotions can take it past the start
+
+	if(pos->pceNum[wB] >= 2) entry->imbalance += BishopPair;
+	if(pos->pceNum[bB] >= 2) entry->imbalance -= BishopPair;
+
+	FindEndgame(pos, entry);
+	if(entry->evaluate != NULL) {
+		return;
+	}
+
+	if(!pos->pceNum[wP] && !pos->pceNum[bP] && MaterialDraw(pos) == TRUE) {
+		entry->scale[WHITE] = 0;
+		entry->scale[BLACK] = 0;
+		return;
+	}
+
+	// without pawns a side at most a minor piece up can seldom win, with only a minor it never can
+	for(side = WHITE; side <= BLACK; ++side) {
+		if(pos->pceNum[side == WHITE ? wP : bP] == 0 && nonPawn[side] - nonPawn[side ^ 1] <= PieceVal[wB]) {
+			entry->scale[side] = nonPawn[side] < PieceVal[wR] ? 0 : nonPawn[side ^ 1] <= PieceVal[wB] ? 4 : 14;
+		}
+	}
+}
+
+// ProbeMaterialTable returns the material data of the position, working it out on a miss
+const S_MATERIALENTRY *ProbeMaterialTable(const S_BOARD *pos) {
+
+	S_MATERIALTABLE *table = pos->MaterialTable;
+	S_MATERIALENTRY *entry = &table->entry[pos->materialKey & (MATERIAL_HASH_ENTRIES - 1)];
+
+	if(entry->materialKey == pos->materialKey) {
+		table->hit++;
+	} else {
+		table->miss++;
+		EvalMaterial(pos, entry);
+	}
+	return entry;
+}
@@ -1,28 +1,94 @@
 // misc.c
 
 #include "stdio.h"
+#include "stdlib.h"
 #include "defs.h"
 
+#include "string.h"
+#include "pthread.h"
+
 #ifdef WIN32
 #include "windows.h"
 #else
+#include "time.h"
 #include "sys/time.h"
 #include "sys/select.h"
+#include "sys/mman.h"
+#include "sys/syscall.h"
+#include "sys/stat.h"
+#include "fcntl.h"
 #include "unistd.h"
-#include "string.h"
 #endif
 
-int GetTimeMs() {//get the time in milliseconds for the search
+#define LARGE_PAGE_SIZE (2ULL * 1024 * 1024)
+#define MAX_CLEAR_THREADS 64
+#define CLEAR_CHUNK_MIN (64ULL * 1024 * 1024) //below this one thread clears faster than several start
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+long long GetTimeMs() {//get the time in milliseconds for the search
 #ifdef WIN32//if the operating system is windows
-  return GetTickCount();//return the tick count
+  return GetTickCount64();//return the tick count
 #else//if the operating system is not windows like linux
-  struct timeval t;//create a timeval structure
-  gettimeofday(&t, NULL);//get the time of day
-  return t.tv_sec*1000 + t.tv_usec/1000;//return the time in milliseconds
-  //it is the number of seconds multiplied by 1000 plus the number of microseconds divided by 1000
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);//monotonic, so a clock adjustment during a search cannot move the deadline
+  return (long long)t.tv_sec*1000 + t.tv_nsec/1000000;//return the time in milliseconds
+#endif
+}
+
+void SleepMs(const int ms) {
+#ifdef WIN32
+  Sleep(ms);
+#else
+  struct timespec t;
+  t.tv_sec = ms / 1000;
+  t.tv_nsec = (ms % 1000) * 1000000L;
+  nanosleep(&t, NULL);
 #endif
 }
 
+// The search timer runs on its own thread and raises info->stopped when the deadline passes,
+// so the search only has to read a flag and stop latency does not depend on the node rate.
+static pthread_t timerThread;
+static atomic_int timerRunning;
+
+static void *TimerLoop(void *arg) {
+  S_SEARCHINFO *info = (S_SEARCHINFO *)arg;
+  long long left;
+
+  while(atomic_load(&timerRunning)) {
+    if(info->ponder == TRUE) {//the clock only starts on ponderhit
+      SleepMs(5);
+      continue;
+    }
+    left = info->stoptime - GetTimeMs();
+    if(left <= 0) {
+      info->stopped = TRUE;
+      break;
+    }
+    SleepMs(left < 5 ? (int)left : 5);//short naps so StopSearchTimer never waits long
+  }
+  return NULL;
+}
+
+void StartSearchTimer(S_SEARCHINFO *info) {
+  if(info->timeset == FALSE || info->nodesTime != 0) {//a clock counted in nodes is checked by the search itself
+    return;
+  }
+  atomic_store(&timerRunning, TRUE);
+  if(pthread_create(&timerThread, NULL, TimerLoop, info) != 0) {
+    atomic_store(&timerRunning, FALSE);
+    printf("Timer thread failed, the search is only limited by depth\n");
+  }
+}
+
+void StopSearchTimer() {
+  if(atomic_exchange(&timerRunning, FALSE)) {
+    pthread_join(timerThread, NULL);
+  }
+}
+
 
 // http://home.arcor.de/dreamlike/chess/
 int InputWaiting()
@@ -60,23 +126,225 @@ int InputWaiting()
 #endif
 }
 
+// Input that arrives during a search stops it, the bytes read are kept here
+// so the protocol loop can still act on every line afterwards
+static char pendingInput[INPUTBUFFER];
+static int pendingLen = 0;
+
 void ReadInput(S_SEARCHINFO *info) {
   int             bytes;
-  char            input[256] = "", *endc;
 
+    if (pendingLen > 0) {//a command read earlier has not been handled yet
+		info->stopped = TRUE;
+		return;
+    }
     if (InputWaiting()) {
 		info->stopped = TRUE;
 		do {
-		  bytes=read(fileno(stdin),input,256);
+		  bytes=read(fileno(stdin),pendingInput,INPUTBUFFER - 1);
 		} while (bytes<0);
-		endc = strchr(input,'\n');
-		if (endc) *endc=0;
+		pendingLen = bytes;
+		pendingInput[pendingLen] = 0;
+		return;
+    }
+}
+
+// ReadInputLine is fgets() for the xboard and console loops, lines already
+// taken off stdin by ReadInput during a search are returned first
+char *ReadInputLine(char *line, const int size) {
+	char *endc = NULL;
+	int len = 0;
 
-		if (strlen(input) > 0) {
-			if (!strncmp(input, "quit", 4))    {
-			  info->quit = TRUE;
-			}
+	if (pendingLen > 0) {
+		endc = strchr(pendingInput, '\n');
+		len = endc ? (int)(endc - pendingInput) + 1 : pendingLen;
+		if (len > size - 1) {
+			len = size - 1;
 		}
-		return;
+		memcpy(line, pendingInput, len);
+		line[len] = 0;
+		memmove(pendingInput, pendingInput + len, pendingLen - len + 1);
+		pendingLen -= len;
+		if (endc || len == size - 1) {
+			return line;
+		}
+		//the rest of a partly read line is still waiting on stdin
+		fgets(line + len, size - len, stdin);
+		return line;
+	}
+	return fgets(line, size, stdin);
+}
+
+#ifndef WIN32
+// InterleaveNodes spreads the pages of a new mapping over every online NUMA node, so that a
+// table bigger than one node's memory does not pile up on one memory controller. The mbind
+// system call is used directly to avoid a dependency on libnuma, without it nothing happens.
+static void InterleaveNodes(void *mem, const U64 size) {
+#ifdef SYS_mbind
+  FILE *file = fopen("/sys/devices/system/node/online", "r");
+  unsigned long mask = 0;
+  int first = 0, last = 0, nodes = 0;
+  char sep = 0;
+
+  if(file == NULL) {
+    return;
+  }
+  //the list looks like 0-3 or 0,2-3
+  while(fscanf(file, "%d", &first) == 1) {
+    last = first;
+    sep = (char)fgetc(file);
+    if(sep == '-') {
+      if(fscanf(file, "%d", &last) != 1) break;
+      sep = (char)fgetc(file);
+    }
+    for(; first <= last && first < 64; ++first) {
+      mask |= 1UL << first;
+      nodes++;
+    }
+    if(sep != ',') break;
+  }
+  fclose(file);
+
+  if(nodes > 1) {
+    syscall(SYS_mbind, mem, size, MPOL_INTERLEAVE, &mask, 8 * sizeof(mask) + 1, 0);
+  }
+#endif
+}
+#endif
+
+// AllocLargeMemory gets the memory for big tables, on Linux as 2MB pages so the TLB covers
+// far more of the table: explicit huge pages first, then a normal mapping with transparent
+// huge pages requested. The size is rounded up to whole large pages, clearing is left to the caller.
+void *AllocLargeMemory(const U64 size) {
+#ifdef WIN32
+  return _aligned_malloc(size, 64);
+#else
+  U64 allocSize = (size + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE;
+  void *mem = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  mem = mmap(NULL, allocSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if(mem == MAP_FAILED) {
+    mem = mmap(NULL, allocSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) {
+      return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(mem, allocSize, MADV_HUGEPAGE);
+#endif
+  }
+  InterleaveNodes(mem, allocSize);
+  return mem;
+#endif
+}
+
+void FreeLargeMemory(void *mem, const U64 size) {
+  if(mem == NULL) {
+    return;
+  }
+#ifdef WIN32
+  _aligned_free(mem);
+#else
+  munmap(mem, (size + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE);
+#endif
+}
+
+// MapFile maps a whole file copy-on-write: nothing is read until a page is touched and
+// writes stay in memory, the file itself is never changed. Returns NULL if that is not possible.
+void *MapFile(const char *name, U64 *size) {
+#ifdef WIN32
+  *size = 0;
+  return NULL;
+#else
+  struct stat st;
+  void *mem = MAP_FAILED;
+  int fd = open(name, O_RDONLY);
+
+  *size = 0;
+  if(fd < 0) {
+    return NULL;
+  }
+  if(fstat(fd, &st) == 0 && st.st_size > 0) {
+    mem = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);//the mapping keeps the file open
+  if(mem == MAP_FAILED) {
+    return NULL;
+  }
+  *size = (U64)st.st_size;
+  return mem;
+#endif
+}
+
+void UnmapFile(void *mem, const U64 size) {
+#ifndef WIN32
+  if(mem != NULL) {
+    munmap(mem, size);
+  }
+#endif
+}
+
+typedef struct {
+  char *start;
+  U64 size;
+} S_CLEARCHUNK;
+
+static void *ClearChunk(void *arg) {
+  S_CLEARCHUNK *chunk = (S_CLEARCHUNK *)arg;
+  memset(chunk->start, 0, chunk->size);
+  return NULL;
+}
+
+// ClearLargeMemory zeroes a big block with one thread per core, a single thread is bound by
+// one core's memory bandwidth and takes minutes on a table of tens of GB
+void ClearLargeMemory(void *mem, const U64 size) {
+
+  pthread_t threads[MAX_CLEAR_THREADS];
+  S_CLEARCHUNK chunks[MAX_CLEAR_THREADS];
+  int started[MAX_CLEAR_THREADS];
+  int count = 1;
+  int index = 0;
+  U64 chunkSize = 0;
+
+#ifdef WIN32
+  SYSTEM_INFO sysinfo;
+  GetSystemInfo(&sysinfo);
+  count = sysinfo.dwNumberOfProcessors;
+#else
+  count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(count > MAX_CLEAR_THREADS) count = MAX_CLEAR_THREADS;
+  if((U64)count > size / CLEAR_CHUNK_MIN) count = (int)(size / CLEAR_CHUNK_MIN);
+  if(count < 1) count = 1;
+
+  //chunks are cut on 64 byte boundaries so no two threads write the same cache line
+  chunkSize = (size / count + 63) & ~63ULL;
+  for(index = 0; index < count; ++index) {
+    chunks[index].start = (char *)mem + chunkSize * index;
+    chunks[index].size = index == count - 1 ? size - chunkSize * index : chunkSize;
+    started[index] = index > 0 && pthread_create(&threads[index], NULL, ClearChunk, &chunks[index]) == 0;
+  }
+  for(index = 0; index < count; ++index) {
+    if(started[index] == FALSE) {
+      ClearChunk(&chunks[index]);
     }
+  }
+  for(index = 1; index < count; ++index) {
+    if(started[index] == TRUE) {
+      pthread_join(threads[index], NULL);
+    }
+  }
+}
+
+// AllocTable is for the small tables hung off the board, the engine cannot play without them
+void *AllocTable(const size_t size, const char *name) {
+
+  void *table = malloc(size);
+
+  if(table == NULL) {
+    printf("%s Allocation Failed\n", name);
+    exit(1);
+  }
+  return table;
 }
@@ -112,8 +112,12 @@ static void AddCaptureMove( const S_BOARD *pos, int move, S_MOVELIST *list ) {
 	ASSERT(PieceValid(CAPTURED(move)));
 	ASSERT(CheckBoard(pos));
 
+	int pce = pos->pieces[FROMSQ(move)];
+
 	list->moves[list->count].move = move;
-	list->moves[list->count].score = MvvLvaScores[CAPTURED(move)][pos->pieces[FROMSQ(move)]] + 1000000;
+	//capture history only refines the order within roughly one victim class of MVV-LVA
+	list->moves[list->count].score = MvvLvaScores[CAPTURED(move)][pce] + 1000000
+		+ pos->captureHistory[pce][TOSQ(move)][CAPTURED(move)] / 256;
 	list->count++;
 }
 
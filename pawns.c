@@ -0,0 +1,104 @@
+// pawns.c
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "defs.h"
+
+// The pawn structure changes with few moves, so what the eval works out from the pawns alone
+// is kept per pawn key and only worked out again when the pawns have moved.
+
+const int PawnIsolated = S(-10, -15);
+const int PawnPassed[8] = { S(0, 0), S(5, 5), S(10, 10), S(15, 20), S(25, 35), S(40, 60), S(70, 100), S(100, 200) };
+
+// An all zero entry with both sides' files open is exactly the entry of a position without
+// pawns, whose pawn key is 0, so a fresh table needs no separate empty marker.
+void ClearPawnTable(S_PAWNTABLE *table) {
+
+	int index = 0;
+
+	for(index = 0; index < PAWN_HASH_ENTRIES; ++index) {
+		table->entry[index].pawnKey = 0ULL;
+		table->entry[index].passed[WHITE] = 0ULL;
+		table->entry[index].passed[BLACK] = 0ULL;
+		table->entry[index].score = 0;
+		table->entry[index].semiOpen[WHITE] = 0xFF;
+		table->entry[index].semiOpen[BLACK] = 0xFF;
+	}
+	table->hit = 0;
+	table->miss = 0;
+}
+
+// NewPawnTable: about 640KB, the pawn entries of a whole game stay in it
+S_PAWNTABLE *NewPawnTable() {
+
+	S_PAWNTABLE *table = (S_PAWNTABLE *) AllocTable(sizeof(S_PAWNTABLE), "Pawn Table");
+
+	ClearPawnTable(table);
+	return table;
+}
+
+void FreePawnTable(S_PAWNTABLE *table) {
+	free(table);
+}
+
+static void EvalPawnStructure(const S_BOARD *pos, S_PAWNENTRY *entry) {
+
+	int pceNum = 0;
+	int sq = 0;
+	int file = 0;
+
+	entry->pawnKey = pos->pawnKey;
+	entry->passed[WHITE] = 0ULL;
+	entry->passed[BLACK] = 0ULL;
+	entry->score = 0;
+	entry->semiOpen[WHITE] = 0;
+	entry->semiOpen[BLACK] = 0;
+
+	for(pceNum = 0; pceNum < pos->pceNum[wP]; ++pceNum) {
+		sq = pos->pList[wP][pceNum];
+		ASSERT(SqOnBoard(sq));
+
+		if( (IsolatedMask[SQ64(sq)] & pos->pawns[WHITE]) == 0) {
+			entry->score += PawnIsolated;
+		}
+
+		if( (WhitePassedMask[SQ64(sq)] & pos->pawns[BLACK]) == 0) {
+			entry->score += PawnPassed[RanksBrd[sq]];
+			SETBIT(entry->passed[WHITE], SQ64(sq));
+		}
+	}
+
+	for(pceNum = 0; pceNum < pos->pceNum[bP]; ++pceNum) {
+		sq = pos->pList[bP][pceNum];
+		ASSERT(SqOnBoard(sq));
+
+		if( (IsolatedMask[SQ64(sq)] & pos->pawns[BLACK]) == 0) {
+			entry->score -= PawnIsolated;
+		}
+
+		if( (BlackPassedMask[SQ64(sq)] & pos->pawns[WHITE]) == 0) {
+			entry->score -= PawnPassed[7 - RanksBrd[sq]];
+			SETBIT(entry->passed[BLACK], SQ64(sq));
+		}
+	}
+
+	for(file = FILE_A; file <= FILE_H; ++file) {
+		if(!(pos->pawns[WHITE] & FileBBMask[file])) entry->semiOpen[WHITE] |= 1 << file;
+		if(!(pos->pawns[BLACK] & FileBBMask[file])) entry->semiOpen[BLACK] |= 1 << file;
+	}
+}
+
+// ProbePawnTable returns the pawn structure data of the position, working it out on a miss
+const S_PAWNENTRY *ProbePawnTable(const S_BOARD *pos) {
+
+	S_PAWNTABLE *table = pos->PawnTable;
+	S_PAWNENTRY *entry = &table->entry[pos->pawnKey & (PAWN_HASH_ENTRIES - 1)];
+
+	if(entry->pawnKey == pos->pawnKey) {
+		table->hit++;
+	} else {
+		table->miss++;
+		EvalPawnStructure(pos, entry);
+	}
+	return entry;
+}
@@ -48,7 +48,7 @@ void PerftTest(int depth, S_BOARD *pos) {
 	PrintBoard(pos);
 	printf("\nStarting Test To Depth:%d\n",depth);	
 	leafNodes = 0;
-	int start = GetTimeMs();
+	long long start = GetTimeMs();
     S_MOVELIST list[1];
     GenerateAllMoves(pos,list);	
     
@@ -66,7 +66,7 @@ void PerftTest(int depth, S_BOARD *pos) {
         printf("move %d : %s : %ld\n",MoveNum+1,PrMove(move),oldnodes);
     }
 	
-	printf("\nTest Complete : %ld nodes visited in %dms\n",leafNodes,GetTimeMs() - start);
+	printf("\nTest Complete : %ld nodes visited in %lldms\n",leafNodes,GetTimeMs() - start);
 
     return;
 }
@@ -1,179 +1,564 @@
 // pvtable.c
 
 #include "stdio.h"
+#include "string.h"
+#include "pthread.h"
 #include "defs.h"
+#if defined(_MSC_VER)
+#include "intrin.h"
+#endif
 // The term "principal variation" (PV) is commonly used in the context of chess programming. In a chess engine, the principal variation is the sequence of moves that the engine considers to be the best after it has performed its search of the game tree.
 
 // The principal variation is often stored in a data structure known as a PV table or PV line. This allows the engine to remember the best sequence of moves it has found, so that it can play them out on the board, or use them to guide its search in future.
 
-int GetPvLine(const int depth, S_BOARD *pos) {
-// this function gets the principal variation line
-	ASSERT(depth < MAXDEPTH && depth >= 1);
+// An entry is 16 bytes, the data word and the position key xor the data, four to a bucket.
+// These unpack the data word, the bit layout is described with S_HASHENTRY in defs.h.
+#define ENTRY_SCORE(e) ((short)(e))
+#define ENTRY_EVAL(e) ((short)((e) >> 16))
+#define ENTRY_MOVE(e) ((unsigned short)(((e) >> 32) & 0x7FFF))
+#define ENTRY_DEPTH(e) ((int)(((e) >> 47) & 0x7F))
+#define ENTRY_BOUND(e) ((int)(((e) >> 54) & 3))
+#define ENTRY_GEN(e) ((int)((e) >> 56))
+#define ENTRY_PACK(move,score,eval,depth,bound,gen) ((U64)(unsigned short)(score) | ((U64)(unsigned short)(eval) << 16) | \
+	((U64)(move) << 32) | ((U64)(depth) << 47) | ((U64)(bound) << 54) | ((U64)(gen) << 56))
 
-	int move = ProbePvMove(pos);
-	//probe the principal variation move
-	int count = 0;///initialize the count to 0
-	
-	while(move != NOMOVE && count < depth) {
-	//while the move is not no move and the count is less than the depth
-		ASSERT(count < MAXDEPTH);//assert that the count is less than the maximum depth
-	
-		if( MoveExists(pos, move) ) {//if the move exists
-			MakeMove(pos, move);//make the move
-			pos->PvArray[count++] = move;//store the move in the principal variation array
-		} else {
-			break;
-		}		
-		move = ProbePvMove(pos);//probe the principal variation move
+// promotions are stored as 1-4 for N,B,R,Q, the colour comes from the pawn on the from square
+static const int PromoteIndex[13] = { 0, 0, 1, 2, 3, 4, 0, 0, 1, 2, 3, 4, 0 };
+
+// A saved table is a page of header followed by the buckets exactly as they are in memory,
+// so a loaded file is searched where it is mapped and only the pages used are ever read
+#define HASH_FILE_MAGIC "VICEHASH"
+#define HASH_FILE_VERSION 1
+#define HASH_FILE_HEADER 4096
+
+// A resize or clear asked for while the engine is idle runs on its own thread, nothing may
+// touch the table until WaitForHashJob has returned. Only the protocol thread starts and joins it.
+// Every way into the table below checks that under DEBUG. The prefetch in MakeMove skips it instead.
+static pthread_t hashJobThread;
+static int hashJobRunning = FALSE;
+
+typedef struct {
+	S_HASHTABLE *table;
+	int MB;//the size to resize to, 0 to clear
+} S_HASHJOB;
+
+static S_HASHJOB hashJob[1];//handed to the job thread, only rewritten once it has been joined
+
+typedef struct {
+	char magic[8];
+	int version;
+	int entryFormat;
+	int bucketSize;
+	int generation;
+	U64 zobrist;
+	U64 numBuckets;
+} S_HASHFILEHEADER;
+
+// the table is shared, entries are only touched through these so each access is a single word;
+// relaxed order is enough since the key ^ data check catches words from two different stores
+#define LOAD_ENTRY(p) atomic_load_explicit((p), memory_order_relaxed)
+#define STORE_ENTRY(p,e) atomic_store_explicit((p), (e), memory_order_relaxed)
+
+static void WriteEntry(S_HASHENTRY *entry, const U64 posKey, const U64 data) {
+	STORE_ENTRY(&entry->data, data);
+	STORE_ENTRY(&entry->key, posKey ^ data);
+}
+
+// Multiply-shift maps the key onto the buckets without a divide, the high half of the
+// 128-bit product is uniform over [0, numBuckets) for any table size. Without a 128-bit
+// type the top 32 bits of the key do the same, a table never has 2^32 buckets.
+static S_HASHBUCKET *GetBucket(const S_HASHTABLE *table, const U64 posKey) {
+#if defined(__SIZEOF_INT128__)
+	return &table->pTable[(U64)(((unsigned __int128)posKey * table->numBuckets) >> 64)];
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return &table->pTable[__umulh(posKey, table->numBuckets)];
+#else
+	ASSERT(table->numBuckets <= 0xFFFFFFFFULL);
+	return &table->pTable[((posKey >> 32) * table->numBuckets) >> 32];
+#endif
+}
+
+// PrefetchHashEntry starts loading the bucket of a position we are about to reach,
+// by the time the child probes it the cache miss has mostly been paid for.
+// MakeMove also runs on the protocol thread (position, usermove) while a resize may be
+// swapping the buckets out, so nothing is prefetched until the job has been joined.
+void PrefetchHashEntry(const S_HASHTABLE *table, const U64 posKey) {
+	if(hashJobRunning == TRUE) {
+		return;
 	}
-	
-	while(pos->ply > 0) {//this is to take back the moves that were made
-		TakeMove(pos);
+#if defined(__GNUC__)
+	__builtin_prefetch(GetBucket(table, posKey));
+#endif
+}
+
+// EntryValue is what an entry is worth keeping, an empty one less than any other. Every search
+// of age counts for eight plies of depth, the age is taken modulo the wrapping generation.
+// StoreHashEntry and RehashEntry both replace by it.
+static int EntryValue(const U64 data, const int generation) {
+	if(ENTRY_DEPTH(data) == 0) {
+		return -INFINITE;
 	}
-	
-	return count;
-	
+	return ENTRY_DEPTH(data) - 8 * ((generation - ENTRY_GEN(data)) & HASH_GEN_MASK);
+}
+
+static unsigned short PackMove(const int move) {
+	if(move == NOMOVE) {
+		return 0;
+	}
+	return SQ64(FROMSQ(move)) | (SQ64(TOSQ(move)) << 6) | (PromoteIndex[PROMOTED(move)] << 12);
+}
+
+// UnpackMove rebuilds the full move from the position it was stored for, a move that
+// does not fit the position comes out as something the move generator never produces
+// and is simply not matched when the moves are ordered
+static int UnpackMove(const S_BOARD *pos, const unsigned short packed) {
+
+	int from, to, piece, captured, promoted = EMPTY, flag = 0;
+
+	if(packed == 0) {
+		return NOMOVE;
+	}
+	from = SQ120(packed & 0x3F);
+	to = SQ120((packed >> 6) & 0x3F);
+	piece = pos->pieces[from];
+	captured = pos->pieces[to];
+
+	if(PiecePawn[piece]) {
+		if((packed >> 12) != 0) {
+			promoted = (PieceCol[piece] == WHITE ? wP : bP) + (packed >> 12);
+		}
+		if(to == pos->enPas) {
+			flag = MFLAGEP;
+		} else if(abs(to - from) == 20) {
+			flag = MFLAGPS;
+		}
+	} else if(PieceKing[piece] && abs(to - from) == 2) {
+		flag = MFLAGCA;
+	}
+	return from | (to << 7) | (captured << 14) | (promoted << 20) | flag;
+}
+
+// FindEntry returns the slot holding this position and copies its data word to *data, or NULL
+static S_HASHENTRY *FindEntry(const S_BOARD *pos, U64 *data) {
+
+	S_HASHBUCKET *bucket = NULL;
+	int index = 0;
+
+	ASSERT(hashJobRunning == FALSE);
+	bucket = GetBucket(pos->HashTable, pos->posKey);
+
+	for(index = 0; index < HASH_BUCKET_SIZE; ++index) {
+		*data = LOAD_ENTRY(&bucket->entry[index].data);
+		if((LOAD_ENTRY(&bucket->entry[index].key) ^ *data) == pos->posKey && ENTRY_DEPTH(*data) != 0) {
+			return &bucket->entry[index];
+		}
+	}
+	return NULL;
+}
+
+void AddHashStats(S_HASHSTATS *total, const S_HASHSTATS *stats) {
+	total->newWrite += stats->newWrite;
+	total->overWrite += stats->overWrite;
+	total->hit += stats->hit;
+	total->cut += stats->cut;
+}
+
+void ClearHashTable(S_HASHTABLE *table) {//this function clears the hash table, no search may be running
+	ClearLargeMemory(table->pTable, table->numBuckets * sizeof(S_HASHBUCKET));
+	table->generation = 0;
+}
+
+// NewSearchHashTable starts a new generation, what is left from before stays usable but
+// counts as old, so a new game does not have to wait for the whole table to be cleared
+void NewSearchHashTable(S_HASHTABLE *table) {
+	ASSERT(hashJobRunning == FALSE);
+	table->generation = (table->generation + 1) & HASH_GEN_MASK;
+}
+
+// HashFull estimates in permill how much of the table was written by this search,
+// from the entries at the start of the table, which are as good a sample as any
+int HashFull(const S_HASHTABLE *table) {
+
+	U64 data = 0ULL;
+	U64 bucketCount = (HASHFULL_SAMPLE + HASH_BUCKET_SIZE - 1) / HASH_BUCKET_SIZE;
+
+	ASSERT(hashJobRunning == FALSE);
+	U64 bucket = 0;
+	int index = 0;
+	int used = 0;
+
+	if(bucketCount > table->numBuckets) {
+		bucketCount = table->numBuckets;
+	}
+	for(bucket = 0; bucket < bucketCount; ++bucket) {
+		for(index = 0; index < HASH_BUCKET_SIZE; ++index) {
+			data = LOAD_ENTRY(&table->pTable[bucket].entry[index].data);
+			if(ENTRY_DEPTH(data) != 0 && ENTRY_GEN(data) == table->generation) {
+				used++;
+			}
+		}
+	}
+	return (int)(used * 1000 / (bucketCount * HASH_BUCKET_SIZE));
+}
+
+void FreeHashTable(S_HASHTABLE *table) {
+	if(table->mapping != NULL) {
+		UnmapFile(table->mapping, table->mappingSize);
+		table->mapping = NULL;
+	} else {
+		FreeLargeMemory(table->pTable, table->numBuckets * sizeof(S_HASHBUCKET));
+	}
+	table->pTable = NULL;
+}
+
+// RehashEntry puts an entry of the old table into the resized one, over an empty entry or one
+// worth less, so when the table shrinks the deep and recent entries are the ones that stay.
+// Returns 1 when the table holds one entry more than before.
+static int RehashEntry(S_HASHTABLE *table, const U64 posKey, const U64 data) {
+
+	S_HASHBUCKET *bucket = GetBucket(table, posKey);
+	S_HASHENTRY *replace = NULL;
+	int value = EntryValue(data, table->generation);
+	int bestValue = value;
+	int index = 0;
+	U64 old = 0ULL;
+
+	for(index = 0; index < HASH_BUCKET_SIZE; ++index) {
+		old = LOAD_ENTRY(&bucket->entry[index].data);
+		if(ENTRY_DEPTH(old) == 0) {
+			WriteEntry(&bucket->entry[index], posKey, data);
+			return 1;
+		}
+		if(EntryValue(old, table->generation) < bestValue) {
+			replace = &bucket->entry[index];
+			bestValue = EntryValue(old, table->generation);
+		}
+	}
+	if(replace != NULL) {
+		WriteEntry(replace, posKey, data);
+	}
+	return 0;
+}
+
+// ResizeHashTable moves the entries into a table of the new size instead of starting empty.
+// Both tables are held while the entries are copied, if that much memory is not there the
+// current table is kept.
+void ResizeHashTable(S_HASHTABLE *table, const int MB) {
+
+	S_HASHTABLE resized[1];
+	S_HASHENTRY *entry = NULL;
+	U64 bucket = 0;
+	U64 data = 0ULL;
+	U64 kept = 0;
+	int index = 0;
+
+	if(table->pTable == NULL) {
+		InitHashTable(table, MB);
+		return;
+	}
+	resized->numBuckets = 0x100000ULL * MB / sizeof(S_HASHBUCKET);
+	resized->generation = table->generation;
+	resized->mapping = NULL;
+	resized->mappingSize = 0;
+	if(resized->numBuckets == table->numBuckets) {
+		return;
+	}
+	resized->pTable = (S_HASHBUCKET *) AllocLargeMemory(resized->numBuckets * sizeof(S_HASHBUCKET));
+	if(resized->pTable == NULL) {
+		printf("Hash Allocation Failed, keeping %llu entries\n", table->numBuckets * HASH_BUCKET_SIZE);
+		return;
+	}
+	ClearLargeMemory(resized->pTable, resized->numBuckets * sizeof(S_HASHBUCKET));
+
+	for(bucket = 0; bucket < table->numBuckets; ++bucket) {
+		for(index = 0; index < HASH_BUCKET_SIZE; ++index) {
+			entry = &table->pTable[bucket].entry[index];
+			data = LOAD_ENTRY(&entry->data);
+			if(ENTRY_DEPTH(data) != 0) {
+				kept += RehashEntry(resized, LOAD_ENTRY(&entry->key) ^ data, data);
+			}
+		}
+	}
+
+	FreeHashTable(table);
+	*table = *resized;
+	printf("HashTable resized to %llu entries, %llu kept\n", table->numBuckets * HASH_BUCKET_SIZE, kept);
+}
+
+static void *HashJobMain(void *arg) {
+	S_HASHJOB *job = (S_HASHJOB *)arg;
+
+	if(job->MB != 0) {
+		ResizeHashTable(job->table, job->MB);
+	} else {
+		ClearHashTable(job->table);
+	}
+	return NULL;
 }
 
-void ClearHashTable(S_HASHTABLE *table) {//this function clears the hash table
+static void StartHashJob(S_HASHTABLE *table, const int MB) {
+	WaitForHashJob();
+	hashJob->table = table;
+	hashJob->MB = MB;
+	if(pthread_create(&hashJobThread, NULL, HashJobMain, hashJob) == 0) {
+		hashJobRunning = TRUE;
+	} else {
+		HashJobMain(hashJob);
+	}
+}
 
-  S_HASHENTRY *tableEntry;//get the variable for the table entry
-  
-  for (tableEntry = table->pTable; tableEntry < table->pTable + table->numEntries; tableEntry++) {
-	//traverse the table entries              // start of the table + the number of entries
-    tableEntry->posKey = 0ULL;//set the position key to 0
-    tableEntry->move = NOMOVE;//set the move to no move
-    tableEntry->depth = 0;//set the depth to 0
-    tableEntry->score = 0;//set the score to 0
-    tableEntry->flags = 0;//set the flags to 0
-  }
-  table->newWrite=0;
+// StartHashResize resizes the table on a background thread so the engine keeps answering
+void StartHashResize(S_HASHTABLE *table, const int MB) {
+	StartHashJob(table, MB);
+}
+
+// StartHashClear clears the table in the background between games, the clear itself is
+// spread over all cores, and the next search only waits for what is left of it
+void StartHashClear(S_HASHTABLE *table) {
+	StartHashJob(table, 0);
+}
+
+void WaitForHashJob() {
+	if(hashJobRunning == TRUE) {
+		pthread_join(hashJobThread, NULL);
+		hashJobRunning = FALSE;
+	}
+}
+
+// SaveHashTable writes the table to a new file that then replaces name, so a table that
+// was loaded from name stays intact under its mapping while it is being saved
+int SaveHashTable(const S_HASHTABLE *table, const char *name) {
+
+	S_HASHFILEHEADER header;
+	char page[HASH_FILE_HEADER];
+	char tempName[INPUTBUFFER];
+	FILE *file = NULL;
+	int ok = FALSE;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HASH_FILE_MAGIC, sizeof(header.magic));
+	header.version = HASH_FILE_VERSION;
+	header.entryFormat = HASH_ENTRY_FORMAT;
+	header.bucketSize = HASH_BUCKET_SIZE;
+	header.generation = table->generation;
+	header.zobrist = ZobristFingerprint();
+	header.numBuckets = table->numBuckets;
+	memset(page, 0, sizeof(page));
+	memcpy(page, &header, sizeof(header));
+
+	snprintf(tempName, sizeof(tempName), "%s.tmp", name);
+	file = fopen(tempName, "wb");
+	if(file == NULL) {
+		printf("Could not create %s\n", tempName);
+		return FALSE;
+	}
+	ok = fwrite(page, sizeof(page), 1, file) == 1
+		&& fwrite(table->pTable, sizeof(S_HASHBUCKET), table->numBuckets, file) == table->numBuckets;
+	if(fclose(file) != 0) {
+		ok = FALSE;
+	}
+	if(ok == FALSE || rename(tempName, name) != 0) {
+		printf("Could not write %s\n", name);
+		remove(tempName);
+		return FALSE;
+	}
+	printf("HashTable saved to %s, %llu entries\n", name, table->numBuckets * HASH_BUCKET_SIZE);
+	return TRUE;
+}
+
+// LoadHashTable replaces the table with the one saved in name, the file is mapped and
+// used in place instead of being read in. On any mismatch the current table is kept.
+int LoadHashTable(S_HASHTABLE *table, const char *name) {
+
+	S_HASHFILEHEADER header;
+	U64 size = 0;
+	char *mem = (char *) MapFile(name, &size);
+
+	if(mem == NULL) {
+		printf("Could not map %s\n", name);
+		return FALSE;
+	}
+	if(size < HASH_FILE_HEADER) {
+		printf("%s is not a saved hash table\n", name);
+		UnmapFile(mem, size);
+		return FALSE;
+	}
+	memcpy(&header, mem, sizeof(header));
+
+	if(memcmp(header.magic, HASH_FILE_MAGIC, sizeof(header.magic)) != 0) {
+		printf("%s is not a saved hash table\n", name);
+	} else if(header.version != HASH_FILE_VERSION || header.entryFormat != HASH_ENTRY_FORMAT
+		|| header.bucketSize != HASH_BUCKET_SIZE) {
+		printf("%s was saved in another format (version %d, entry format %d)\n",
+			name, header.version, header.entryFormat);
+	} else if(header.zobrist != ZobristFingerprint()) {
+		printf("%s was saved with different hash keys\n", name);
+	} else if(header.numBuckets == 0 || size != HASH_FILE_HEADER + header.numBuckets * sizeof(S_HASHBUCKET)) {
+		printf("%s is truncated\n", name);
+	} else {
+		FreeHashTable(table);
+		table->mapping = mem;
+		table->mappingSize = size;
+		table->pTable = (S_HASHBUCKET *) (mem + HASH_FILE_HEADER);
+		table->numBuckets = header.numBuckets;
+		table->generation = header.generation & HASH_GEN_MASK;
+		printf("HashTable loaded from %s, %llu entries\n", name, table->numBuckets * HASH_BUCKET_SIZE);
+		return TRUE;
+	}
+	UnmapFile(mem, size);
+	return FALSE;
 }
 
 void InitHashTable(S_HASHTABLE *table, const int MB) {  
 	//this function initializes the hash table principal variation table
-	int HashSize = 0x100000 * MB;//the size of the hash table that is one megabyte
-    table->numEntries = HashSize / sizeof(S_HASHENTRY);
-	// the number of entries in the hash table is the size of the hash table divided by the size of a hash entry 
-    table->numEntries -= 2;
-	// it is decremented by 2 to avoid any out of bounds errors
-	
+	U64 HashSize = 0x100000ULL * MB;//the size of the hash table in bytes, 64 bit so tables past 2GB do not overflow
 	
 	if(table->pTable!=NULL) {
-		free(table->pTable);
+		FreeHashTable(table);
 	}
-		
-    table->pTable = (S_HASHENTRY *) malloc(table->numEntries * sizeof(S_HASHENTRY));
-	//dynamic memory allocation for the hash table
+	table->numBuckets = HashSize / sizeof(S_HASHBUCKET);
+
+	//page aligned, so no bucket straddles two cache lines
+	table->pTable = (S_HASHBUCKET *) AllocLargeMemory(table->numBuckets * sizeof(S_HASHBUCKET));
 	if(table->pTable == NULL) {//if the allocation fails
 		printf("Hash Allocation Failed, trying %dMB...\n",MB/2);//print the message
 		InitHashTable(table,MB/2);//initialize the hash table with half the size
 	} else {
-		ClearHashTable(table);//clear the hash table
-		printf("HashTable init complete with %d entries\n",table->numEntries);//print the message 
-		//that the hash table has been initialized with the number of entries
+		ClearHashTable(table);//clear the hash table, on fresh pages this faults them in on all cores at once
+		printf("HashTable init complete with %llu entries\n",table->numBuckets * HASH_BUCKET_SIZE);
 	}
 	
 }
 
-int ProbeHashEntry(S_BOARD *pos, int *move, int *score, int alpha, int beta, int depth) {
+// ProbeHashEntry gives the stored move and static eval (NO_EVAL if there is none) of the position
+// whenever it is in the table, and returns TRUE when the stored bound also settles this node
+int ProbeHashEntry(S_BOARD *pos, int *move, int *score, int *eval, int alpha, int beta, int depth) {
 
-	int index = pos->posKey % pos->HashTable->numEntries;
+	U64 data = 0ULL;
+	S_HASHENTRY *entry = FindEntry(pos, &data);
+	int generation = pos->HashTable->generation;
 	
-	ASSERT(index >= 0 && index <= pos->HashTable->numEntries - 1);
-    ASSERT(depth>=1&&depth<MAXDEPTH);
+    ASSERT(depth>=QS_DEPTH&&depth<MAXDEPTH);
     ASSERT(alpha<beta);
     ASSERT(alpha>=-INFINITE&&alpha<=INFINITE);
     ASSERT(beta>=-INFINITE&&beta<=INFINITE);
     ASSERT(pos->ply>=0&&pos->ply<MAXDEPTH);
 	
-	if( pos->HashTable->pTable[index].posKey == pos->posKey ) {
-		*move = pos->HashTable->pTable[index].move;
-		if(pos->HashTable->pTable[index].depth >= depth){
-			pos->HashTable->hit++;
-			
-			ASSERT(pos->HashTable->pTable[index].depth>=1&&pos->HashTable->pTable[index].depth<MAXDEPTH);
-            ASSERT(pos->HashTable->pTable[index].flags>=HFALPHA&&pos->HashTable->pTable[index].flags<=HFEXACT);
-			
-			*score = pos->HashTable->pTable[index].score;
-			if(*score > ISMATE) *score -= pos->ply;
-            else if(*score < -ISMATE) *score += pos->ply;
-			
-			switch(pos->HashTable->pTable[index].flags) {
-				
-                ASSERT(*score>=-INFINITE&&*score<=INFINITE);
-
-                case HFALPHA: if(*score<=alpha) {
-                    *score=alpha;
-                    return TRUE;
-                    }
-                    break;
-                case HFBETA: if(*score>=beta) {
-                    *score=beta;
-                    return TRUE;
-                    }
-                    break;
-                case HFEXACT:
-                    return TRUE;
-                    break;
-                default: ASSERT(FALSE); break;
-            }
-		}
+	*eval = NO_EVAL;
+	if(entry == NULL) {
+		return FALSE;
+	}
+
+	if(ENTRY_GEN(data) != generation) {//still in use, keep it from ageing out
+		WriteEntry(entry, pos->posKey, (data & ~(0xFFULL << 56)) | ((U64)generation << 56));
+	}
+	*move = UnpackMove(pos, ENTRY_MOVE(data));
+	*eval = ENTRY_EVAL(data);
+	if(ENTRY_DEPTH(data) - HASH_DEPTH_OFFSET < depth) {
+		return FALSE;
+	}
+	pos->hashStats.hit++;
+
+	ASSERT(ENTRY_DEPTH(data)-HASH_DEPTH_OFFSET>=QS_DEPTH&&ENTRY_DEPTH(data)-HASH_DEPTH_OFFSET<MAXDEPTH);
+	ASSERT(ENTRY_BOUND(data)>=HFALPHA&&ENTRY_BOUND(data)<=HFEXACT);
+
+	*score = ENTRY_SCORE(data);
+	if(*score > ISMATE) *score -= pos->ply;
+	else if(*score < -ISMATE) *score += pos->ply;
+
+	ASSERT(*score>=-INFINITE&&*score<=INFINITE);
+
+	switch(ENTRY_BOUND(data)) {
+		case HFALPHA: if(*score<=alpha) {
+			*score=alpha;
+			return TRUE;
+			}
+			break;
+		case HFBETA: if(*score>=beta) {
+			*score=beta;
+			return TRUE;
+			}
+			break;
+		case HFEXACT:
+			return TRUE;
+			break;
+		default: ASSERT(FALSE); break;
 	}
 	
 	return FALSE;
 }
 
-void StoreHashEntry(S_BOARD *pos, const int move, int score, const int flags, const int depth) {
+// StoreHashEntry writes over the entry of the same position if there is one, otherwise over
+// the entry of the bucket that is worth least: empty first, then shallow and from old searches.
+// eval is the static evaluation of the position or NO_EVAL when the node did not need one.
+void StoreHashEntry(S_BOARD *pos, const int move, int score, const int eval, const int flags, const int depth) {
 
-	int index = pos->posKey % pos->HashTable->numEntries;
+	S_HASHBUCKET *bucket = NULL;
+	S_HASHENTRY *replace = NULL;
+	U64 data = 0ULL;
+	U64 replaceData = 0ULL;
+	unsigned short packedMove = PackMove(move);
+	int staticEval = eval;
+	int generation = pos->HashTable->generation;
+	int index = 0;
+	int value = 0;
+	int bestValue = 0;
+	int samePosition = FALSE;
 	
-	ASSERT(index >= 0 && index <= pos->HashTable->numEntries - 1);
-	ASSERT(depth>=1&&depth<MAXDEPTH);
+	ASSERT(depth>=QS_DEPTH&&depth<MAXDEPTH);
     ASSERT(flags>=HFALPHA&&flags<=HFEXACT);
     ASSERT(score>=-INFINITE&&score<=INFINITE);
+    ASSERT(eval==NO_EVAL||(eval>-INFINITE&&eval<INFINITE));
     ASSERT(pos->ply>=0&&pos->ply<MAXDEPTH);
+	ASSERT(hashJobRunning == FALSE);
+
+	bucket = GetBucket(pos->HashTable, pos->posKey);
+	for(index = 0; index < HASH_BUCKET_SIZE; ++index) {
+		data = LOAD_ENTRY(&bucket->entry[index].data);
+		if((LOAD_ENTRY(&bucket->entry[index].key) ^ data) == pos->posKey && ENTRY_DEPTH(data) != 0) {
+			replace = &bucket->entry[index];
+			replaceData = data;
+			samePosition = TRUE;
+			break;
+		}
+		value = EntryValue(data, generation);
+		if(replace == NULL || value < bestValue) {
+			replace = &bucket->entry[index];
+			replaceData = data;
+			bestValue = value;
+		}
+	}
 	
-	if( pos->HashTable->pTable[index].posKey == 0) {
-		pos->HashTable->newWrite++;
+	if(samePosition == TRUE) {
+		//a much shallower bound on the same position keeps the deeper result, unless it is exact
+		if(flags != HFEXACT && depth + HASH_DEPTH_OFFSET < ENTRY_DEPTH(replaceData) - 2) {
+			return;
+		}
+		if(move == NOMOVE) {//a store without a move keeps the one we had for the ordering
+			packedMove = ENTRY_MOVE(replaceData);
+		}
+		if(eval == NO_EVAL) {
+			staticEval = ENTRY_EVAL(replaceData);
+		}
+	} else if(ENTRY_DEPTH(replaceData) == 0) {
+		pos->hashStats.newWrite++;
 	} else {
-		pos->HashTable->overWrite++;
+		pos->hashStats.overWrite++;
 	}
 	
 	if(score > ISMATE) score += pos->ply;
     else if(score < -ISMATE) score -= pos->ply;
 	
-	pos->HashTable->pTable[index].move = move;
-    pos->HashTable->pTable[index].posKey = pos->posKey;
-	pos->HashTable->pTable[index].flags = flags;
-	pos->HashTable->pTable[index].score = score;
-	pos->HashTable->pTable[index].depth = depth;
+	WriteEntry(replace, pos->posKey, ENTRY_PACK(packedMove, score, staticEval, depth + HASH_DEPTH_OFFSET, flags, generation));
 }
 
 int ProbePvMove(const S_BOARD *pos) {
 	// to probe the principal variation move
-	int index = pos->posKey % pos->HashTable->numEntries;//indexed based on the position key and the number of entries in the hash table
-	ASSERT(index >= 0 && index <= pos->HashTable->numEntries - 1);//assert that the index is valid
-	
-	if( pos->HashTable->pTable[index].posKey == pos->posKey ) {//if the position key matches
-		return pos->HashTable->pTable[index].move;//return the move
+	U64 data = 0ULL;
+
+	if(FindEntry(pos, &data) != NULL) {
+		return UnpackMove(pos, ENTRY_MOVE(data));
 	}
 	
 	return NOMOVE;//return no move if the move is not found
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
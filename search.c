@@ -2,6 +2,7 @@
 
 #include "stdio.h"
 #include "defs.h"
+#include "string.h"
 // hisPly typically represents the total number of half-moves made in the game so far,
 // from the starting position to the current position. 
 //It's often used to access game history information, such as the positions 
@@ -10,13 +11,15 @@
 //from the root position to the current position.
 int rootDepth;
 
+#define DELTA_MARGIN 200
+#define INFOBUFFER 1024
+
 static void CheckUp(S_SEARCHINFO *info) {
-	// .. check if time up, or interrupt from GUI
-	if(info->timeset == TRUE && GetTimeMs() > info->stoptime) {
-		info->stopped = TRUE;
+	// .. check for an interrupt from GUI, the time limit is watched by the timer thread
+	// and in UCI mode the protocol thread reads the input and raises info->stopped itself
+	if(info->GAME_MODE != UCIMODE && info->nodeLimit == 0) {//node limited searches never poll, so they replay exactly
+		ReadInput(info);
 	}
-
-	ReadInput(info);
 }
 //hm. By examining promising moves first, the algorithm can prune larger portions of the search tree early on. This is because alpha-beta pruning's effectiveness is heavily dependent on the order in which moves are evaluated. 
 //If the best moves are evaluated early, it leads to more pruning opportunities, reducing the number of nodes the algorithm needs to examine.
@@ -27,10 +30,10 @@ static void PickNextMove(int moveNum, S_MOVELIST *list) {
 //
 	S_MOVE temp;
 	int index = 0;
-	int bestScore = 0;
+	int bestScore = list->moves[moveNum].score;//history scores can be negative so start from the first remaining move
 	int bestNum = moveNum;
 
-	for (index = moveNum; index < list->count; ++index) {//for all the moves in the list
+	for (index = moveNum + 1; index < list->count; ++index) {//for all the moves in the list
 		if (list->moves[index].score > bestScore) {//if the score of the move is greater than the best score
 			bestScore = list->moves[index].score;//set the best score to the score of the move
 			bestNum = index;//set the best number to the index
@@ -49,27 +52,101 @@ static void PickNextMove(int moveNum, S_MOVELIST *list) {
 static int IsRepetition(const S_BOARD *pos) {//this function checks if the position is a repetition
 
 	int index = 0;
+	int first = pos->hisPly - pos->fiftyMove;
 
-	for(index = pos->hisPly - pos->fiftyMove; index < pos->hisPly-1; ++index) {
-		//if the position key is equal to the position key of the previous position
+	if(first < 0) {
+		first = 0;
+	}
+	//a position can only come back with the same side to move, so only every second entry is compared,
+	//and nothing before the last capture or pawn move can be the same position
+	for(index = pos->hisPly - 4; index >= first; index -= 2) {
 		ASSERT(index >= 0 && index < MAXGAMEMOVES);
-		if(pos->posKey == pos->history[index].posKey) {//if the position key is equal to the position key of the previous position
+		if(pos->posKey == pos->history[index].posKey) {//if the position key is equal to the position key of the earlier position
 			return TRUE;//return true
 		}
 	}
 	return FALSE;//return false
 }
-//The ClearForSearch function in the search.c file is used to reset or initialize certain values before starting a new search in the chess engine. Here's what it does:
-static void ClearForSearch(S_BOARD *pos, S_SEARCHINFO *info) {
+
+static int PathClear(const S_BOARD *pos, const int from, const int to) {//are the squares between from and to empty
+
+	int df = FilesBrd[to] - FilesBrd[from];
+	int dr = RanksBrd[to] - RanksBrd[from];
+	int dir = 0;
+	int sq = 0;
+
+	if(df != 0 && dr != 0 && abs(df) != abs(dr)) {//knight jump, nothing in between
+		return TRUE;
+	}
+
+	dir = ((dr > 0) - (dr < 0)) * 10 + ((df > 0) - (df < 0));
+	for(sq = from + dir; sq != to; sq += dir) {
+		if(pos->pieces[sq] != EMPTY) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// UpcomingRepetition tells if the side to move has a reversible move that goes back to a position
+// already seen in the search line, that line is then at least a draw and can be cut before it is played.
+// The key difference to each earlier position with the other side to move is looked up in the cuckoo tables.
+static int UpcomingRepetition(const S_BOARD *pos) {
+
+	int index = 0;
+	int slot = 0;
+	int end = pos->fiftyMove < pos->ply ? pos->fiftyMove : pos->ply - 1;
+	U64 moveKey = 0ULL;
+
+	for(index = 3; index <= end; index += 2) {
+		moveKey = pos->posKey ^ pos->history[pos->hisPly - index].posKey;
+		slot = CUCKOO_H1(moveKey);
+		if(CuckooKeys[slot] != moveKey) {
+			slot = CUCKOO_H2(moveKey);
+			if(CuckooKeys[slot] != moveKey) {
+				continue;
+			}
+		}
+		if(PathClear(pos, FROMSQ(CuckooMoves[slot]), TOSQ(CuckooMoves[slot]))) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Gravity update: the closer an entry already is to HISTORY_MAX, the less a bonus moves it,
+// so the tables stay bounded without ever needing to be rescaled or wiped.
+static void UpdateHistory(int *entry, const int bonus) {
+	*entry += bonus - *entry * abs(bonus) / HISTORY_MAX;
+	ASSERT(*entry >= -HISTORY_MAX && *entry <= HISTORY_MAX);
+}
+
+static int HistoryBonus(const int depth) {
+	int bonus = depth * depth;
+	return bonus > HISTORY_MAX / 8 ? HISTORY_MAX / 8 : bonus;
+}
+
+static void UpdateQuietHistory(S_BOARD *pos, const int move, const int bonus) {
+	UpdateHistory(&pos->searchHistory[pos->pieces[FROMSQ(move)]][TOSQ(move)], bonus);
+}
+
+static void UpdateCaptureHistory(S_BOARD *pos, const int move, const int bonus) {
+	UpdateHistory(&pos->captureHistory[pos->pieces[FROMSQ(move)]][TOSQ(move)][CAPTURED(move)], bonus);
+}
+
+// ClearSearchHistory wipes all move ordering data, it is only needed when a new game starts.
+void ClearSearchHistory(S_BOARD *pos) {
 
 	int index = 0;
 	int index2 = 0;
-	//resetting the search history and search killers arrays
-	//setting the history heuristic scores to 0 
-	//Resetting it ensures that the scores from the previous search do not affect the new search
+	int index3 = 0;
+
 	for(index = 0; index < 13; ++index) {
 		for(index2 = 0; index2 < BRD_SQ_NUM; ++index2) {
 			pos->searchHistory[index][index2] = 0;
+			for(index3 = 0; index3 < 13; ++index3) {
+				pos->captureHistory[index][index2][index3] = 0;
+			}
 		}
 	}
 
@@ -78,14 +155,94 @@ static void ClearForSearch(S_BOARD *pos, S_SEARCHINFO *info) {
 			pos->searchKillers[index][index2] = 0;
 		}
 	}
+}
+
+//The ClearForSearch function in the search.c file is used to reset or initialize certain values before starting a new search in the chess engine. Here's what it does:
+// UpdatePv makes move followed by the child's line the PV of the current ply
+static void UpdatePv(S_BOARD *pos, const int move) {
+	int ply = pos->ply;
+	int index = 0;
+
+	pos->pvTable[ply][ply] = move;
+	for(index = ply + 1; index < pos->pvLength[ply + 1]; ++index) {
+		pos->pvTable[ply][index] = pos->pvTable[ply + 1][index];
+	}
+	pos->pvLength[ply] = pos->pvLength[ply + 1];
+}
+
+// PvFromHash makes move followed by the stored best moves the PV of the current ply, for a node
+// an exact entry settles inside the window. The walk ends at a missing or illegal move or a repetition.
+static void PvFromHash(S_BOARD *pos, int move) {
+	int ply = pos->ply;
+	int made = 0;
+
+	while(move != NOMOVE && pos->ply < MAXDEPTH - 1 && MoveExists(pos, move)) {
+		pos->pvTable[ply][pos->ply] = move;
+		MakeMove(pos, move);
+		made++;
+		if(IsRepetition(pos)) {
+			break;
+		}
+		move = ProbePvMove(pos);
+	}
+	pos->pvLength[ply] = ply + made;
+	while(made-- > 0) {
+		TakeMove(pos);
+	}
+}
+
+// PonderFromHash is the reply the table stores after move, for a best move whose PV ends there
+static int PonderFromHash(S_BOARD *pos, const int move) {
+	int reply = NOMOVE;
+
+	if(MakeMove(pos, move)) {
+		reply = ProbePvMove(pos);
+		if(reply != NOMOVE && !MoveExists(pos, reply)) {
+			reply = NOMOVE;
+		}
+		TakeMove(pos);
+	}
+	return reply;
+}
 
-	pos->HashTable->overWrite=0;
-	pos->HashTable->hit=0;
-	pos->HashTable->cut=0;
+static void ClearForSearch(S_BOARD *pos, S_SEARCHINFO *info) {
+
+	int index = 0;
+	int index2 = 0;
+	int index3 = 0;
+	//the history tables are aged rather than cleared, consecutive moves of a game
+	//search mostly the same tree so the old scores are still a good guess, just a less certain one
+	for(index = 0; index < 13; ++index) {
+		for(index2 = 0; index2 < BRD_SQ_NUM; ++index2) {
+			pos->searchHistory[index][index2] /= 2;
+			for(index3 = 0; index3 < 13; ++index3) {
+				pos->captureHistory[index][index2][index3] /= 2;
+			}
+		}
+	}
+
+	//two plies have been played since the last search, so the killers of ply n+2 now belong to ply n
+	for(index = 0; index < 2; ++index) {
+		for(index2 = 0; index2 < MAXDEPTH; ++index2) {
+			pos->searchKillers[index][index2] = index2 + 2 < MAXDEPTH ? pos->searchKillers[index][index2 + 2] : NOMOVE;
+		}
+	}
+
+	pos->hashStats.newWrite=0;
+	pos->hashStats.overWrite=0;
+	pos->hashStats.hit=0;
+	pos->hashStats.cut=0;
+	memset(&pos->evalStats, 0, sizeof(pos->evalStats));
+	NewSearchHashTable(pos->HashTable);
 	pos->ply = 0;//set it to 0 after the search
 
-	info->stopped = 0;
+	if(info->GAME_MODE != UCIMODE) {//a UCI stop may already be in, StartSearch clears the flag
+		info->stopped = 0;
+	}
 	info->nodes = 0;
+	info->lastBestMove = NOMOVE;
+	info->lastScore = 0;
+	info->bestMoveStable = 0;
 	info->fh = 0;
 	info->fhf = 0;
 }
@@ -98,10 +255,17 @@ static int Quiescence(int alpha, int beta, S_BOARD *pos, S_SEARCHINFO *info) {
 	
 	ASSERT(CheckBoard(pos));//check the board
 	ASSERT(beta>alpha);//assert that beta is greater than alpha
+	pos->pvLength[pos->ply] = pos->ply;//empty line until a move raises alpha
+
 	if(( info->nodes & 2047 ) == 0) {
 		CheckUp(info);
 	}
 
+	if(info->nodeLimit != 0 && info->nodes >= info->nodeLimit && rootDepth > 1) {//depth 1 always completes so there is a move to play
+		info->stopped = TRUE;
+		return 0;
+	}
+
 	info->nodes++;//increment the number of nodes
 
 	if(IsRepetition(pos) || pos->fiftyMove >= 100) {
@@ -112,30 +276,84 @@ static int Quiescence(int alpha, int beta, S_BOARD *pos, S_SEARCHINFO *info) {
 		return EvalPosition(pos);//return the evaluation of the position
 	}
 
-	int Score = EvalPosition(pos);//get the evaluation of the position
+	//when in check there is no stand pat, every evasion is searched instead of only the captures
+	int InCheck = SqAttacked(pos->KingSq[pos->side],pos->side^1,pos);
+	int TTDepth = InCheck ? QS_DEPTH_EVASION : QS_DEPTH;
+	int Score = -INFINITE;
+	int PvMove = NOMOVE;
+	int StaticEval = NO_EVAL;
+
+	if( ProbeHashEntry(pos, &PvMove, &Score, &StaticEval, alpha, beta, TTDepth) == TRUE ) {
+		pos->hashStats.cut++;
+		if(Score > alpha && Score < beta) {//an exact score that becomes part of the PV
+			PvFromHash(pos, PvMove);
+		}
+		return Score;
+	}
 
-	ASSERT(Score>-INFINITE && Score<INFINITE);//assert that the score is valid
+	int OldAlpha = alpha;
+	int StandPat = -INFINITE;
+	S_MOVELIST list[1];//create a move list
 
-	if(Score >= beta) {//if the score is greater than or equal to beta then we already have a good move
-		return beta;
-	}
+	int Lazy = FALSE;
 
-	if(Score > alpha) {//if the score is greater than alpha
-		alpha = Score;
-	}
+	if(InCheck) {
+		GenerateAllMoves(pos,list);
+	} else {
+		if(StaticEval == NO_EVAL) {//the table did not have it, evaluate
+			//a lazy estimate is good enough to stand pat or prune with but is not stored as the static eval
+			StandPat = EvalPositionLazy(pos, alpha, beta, &Lazy);
+			if(Lazy == FALSE) StaticEval = StandPat;
+		} else {
+			StandPat = StaticEval;
+			pos->evalStats.hashEval++;
+		}
+		ASSERT(Lazy || StaticEval == EvalPosition(pos));
 
-	S_MOVELIST list[1];//create a move list
-    GenerateAllCaps(pos,list);//generate all the captures in the position
+		ASSERT(StandPat>-INFINITE && StandPat<INFINITE);//assert that the score is valid
+
+		if(StandPat >= beta) {//if the score is greater than or equal to beta then we already have a good move
+			StoreHashEntry(pos, NOMOVE, beta, StaticEval, HFBETA, TTDepth);
+			return beta;
+		}
+
+		if(StandPat > alpha) {//if the score is greater than alpha
+			alpha = StandPat;
+		}
+
+		GenerateAllCaps(pos,list);//generate all the captures in the position
+	}
 
     int MoveNum = 0;//set the Movenum to 0
 	int Legal = 0;
+	int Move = NOMOVE;
+	int BestMove = NOMOVE;
+	int Gain = 0;
 	Score = -INFINITE;
 
+	if( PvMove != NOMOVE) {
+		for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {
+			if( list->moves[MoveNum].move == PvMove) {
+				list->moves[MoveNum].score = 2000000;
+				break;
+			}
+		}
+	}
+
 	for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {//traverse through all the moves in movelist
 
 		PickNextMove(MoveNum, list);//pick the next move
+		Move = list->moves[MoveNum].move;
+
+		//delta pruning: even winning the captured piece for free, plus a margin, cannot lift the score to alpha
+		if(!InCheck && PROMOTED(Move) == EMPTY) {
+			Gain = (Move & MFLAGEP) ? PieceVal[wP] : PieceVal[CAPTURED(Move)];
+			if(StandPat + Gain + DELTA_MARGIN <= alpha) {
+				continue;
+			}
+		}
 
-        if ( !MakeMove(pos,list->moves[MoveNum].move))  {//if the move is not legal
+        if ( !MakeMove(pos,Move))  {//if the move is not legal
             continue;//continue
         }
 
@@ -149,19 +367,32 @@ static int Quiescence(int alpha, int beta, S_BOARD *pos, S_SEARCHINFO *info) {
 		}
 
 		if(Score > alpha) {//if the score is greater than alpha
+			BestMove = Move;
 			if(Score >= beta) {//if the score is greater than or equal to beta
 				if(Legal==1) {//if the move is the first legal move
 					info->fhf++;//increment the fail high first counter
 				}
 				info->fh++;//increment the fail high counter
+				StoreHashEntry(pos, BestMove, beta, StaticEval, HFBETA, TTDepth);
 				return beta;//return beta
 			}
 			alpha = Score;//set alpha to the score
+			UpdatePv(pos, Move);
 		}
     }
 
+	if(InCheck && Legal == 0) {//no evasion, this is mate
+		return -INFINITE + pos->ply;
+	}
+
 	ASSERT(alpha >= OldAlpha);//assert that alpha is greater than or equal to old alpha
 
+	if(alpha != OldAlpha) {
+		StoreHashEntry(pos, BestMove, alpha, StaticEval, HFEXACT, TTDepth);
+	} else {
+		StoreHashEntry(pos, BestMove, alpha, StaticEval, HFALPHA, TTDepth);
+	}
+
 	return alpha;//return alpha
 }
 
@@ -171,6 +402,7 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 	ASSERT(CheckBoard(pos));//check the board
 	ASSERT(beta>alpha);//assert that beta is greater than alpha
 	ASSERT(depth>=0);//assert that the depth is greater than or equal to 0
+	pos->pvLength[pos->ply] = pos->ply;//empty line until a move raises alpha
 
 	if(depth <= 0) {
 		return Quiescence(alpha, beta, pos, info);
@@ -183,6 +415,11 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 		CheckUp(info);
 	}
 
+	if(info->nodeLimit != 0 && info->nodes >= info->nodeLimit && rootDepth > 1) {//depth 1 always completes so there is a move to play
+		info->stopped = TRUE;
+		return 0;
+	}
+
 	info->nodes++;//increment the number of nodes
 //IsRepetition(pos): This function checks if the current position (pos) on the board has been repeated. In chess, the threefold repetition rule states that a game is drawn if the 
 //same position occurs three times with the same player to move and all possible moves.
@@ -192,6 +429,13 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 		return 0;
 	}
 
+	if(alpha < 0 && pos->ply && UpcomingRepetition(pos)) {//we can at least draw by going back
+		alpha = 0;
+		if(alpha >= beta) {
+			return beta;
+		}
+	}
+
 	if(pos->ply > MAXDEPTH - 1) {//if u have reached the maximum depth
 		return EvalPosition(pos);//return the evaluation of the position
 	}
@@ -206,9 +450,13 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 
 	int Score = -INFINITE;//set the score to negative infinity minimum value
 	int PvMove = NOMOVE;//set the principal variation move to no move
+	int StaticEval = NO_EVAL;
 
-	if( ProbeHashEntry(pos, &PvMove, &Score, alpha, beta, depth) == TRUE ) {
-		pos->HashTable->cut++;
+	if( ProbeHashEntry(pos, &PvMove, &Score, &StaticEval, alpha, beta, depth) == TRUE ) {
+		pos->hashStats.cut++;
+		if(Score > alpha && Score < beta) {//an exact score that becomes part of the PV
+			PvFromHash(pos, PvMove);
+		}
 		return Score;
 	}
 
@@ -233,6 +481,12 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 	int Legal = 0;
 	int OldAlpha = alpha;
 	int BestMove = NOMOVE;
+	int Move = NOMOVE;
+	int QuietsTried[MAXPOSITIONMOVES];
+	int CapturesTried[MAXPOSITIONMOVES];
+	int QuietCount = 0;
+	int CaptureCount = 0;
+	int index = 0;
 
 	int BestScore = -INFINITE;
 
@@ -257,7 +511,8 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 		//for all the moves in the list
 		PickNextMove(MoveNum, list);
 		//pick the next move
-        if ( !MakeMove(pos,list->moves[MoveNum].move))  {
+		Move = list->moves[MoveNum].move;
+        if ( !MakeMove(pos,Move))  {
             continue;
         }//if the move is not legal, continue
 
@@ -281,23 +536,39 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 					info->fh++;
 	// Stands for "fail-high." This counter is incremented every time a move causes a beta cutoff. A beta cutoff occurs when the engine finds a move that is so good for the player making the move that it assumes the opponent will avoid the position,
 	// leading the engine to prune the rest of the moves at that node. The fh counter tracks how often these cutoffs happen, which is an indicator of how effective the move ordering is.				
-					if(!(list->moves[MoveNum].move & MFLAGCAP)) {
+    //Higher Weight to Deeper Cutoffs: Moves that cause cutoffs at deeper levels of the search tree are generally more valuable for pruning the search space efficiently. By growing the history value with the depth at which the cutoff occurred, moves that prove effective at deeper levels are given more weight. 
+	//The moves of the same kind that were tried first and failed to cut are pushed down by the same amount.
+					if(!(Move & MFLAGCAP)) {
 						pos->searchKillers[1][pos->ply] = pos->searchKillers[0][pos->ply];
-						pos->searchKillers[0][pos->ply] = list->moves[MoveNum].move;
+						pos->searchKillers[0][pos->ply] = Move;
+						UpdateQuietHistory(pos, Move, HistoryBonus(depth));
+						for(index = 0; index < QuietCount; ++index) {
+							UpdateQuietHistory(pos, QuietsTried[index], -HistoryBonus(depth));
+						}
+					} else if(CAPTURED(Move) != EMPTY) {
+						UpdateCaptureHistory(pos, Move, HistoryBonus(depth));
+						for(index = 0; index < CaptureCount; ++index) {
+							UpdateCaptureHistory(pos, CapturesTried[index], -HistoryBonus(depth));
+						}
 					}
-    //Higher Weight to Deeper Cutoffs: Moves that cause cutoffs at deeper levels of the search tree are generally more valuable for pruning the search space efficiently. By incrementing the history value by the depth at which the cutoff occurred, moves that prove effective at deeper levels are given more weight. 
-	//This means they will be considered more favorable in future move ordering, potentially leading to earlier cutoffs and a more efficient search
-					StoreHashEntry(pos, BestMove, beta, HFBETA, depth);
+					StoreHashEntry(pos, BestMove, beta, StaticEval, HFBETA, depth);
 
 					return beta;
 				}
 				alpha = Score;
+				UpdatePv(pos, Move);
 				//this is to do the alp
-				if(!(list->moves[MoveNum].move & MFLAGCAP)) {
-					pos->searchHistory[pos->pieces[FROMSQ(BestMove)]][TOSQ(BestMove)] += depth;
+				if(!(Move & MFLAGCAP)) {
+					UpdateQuietHistory(pos, Move, HistoryBonus(depth));
 				}
 			}
 		}
+
+		if(!(Move & MFLAGCAP)) {
+			QuietsTried[QuietCount++] = Move;
+		} else if(CAPTURED(Move) != EMPTY) {
+			CapturesTried[CaptureCount++] = Move;
+		}
     }
 
 	if(Legal == 0) {
@@ -311,9 +582,139 @@ static int AlphaBeta(int alpha, int beta, int depth, S_BOARD *pos, S_SEARCHINFO
 	ASSERT(alpha>=OldAlpha);
 
 	if(alpha != OldAlpha) {
-		StoreHashEntry(pos, BestMove, BestScore, HFEXACT, depth);
+		StoreHashEntry(pos, BestMove, BestScore, StaticEval, HFEXACT, depth);
 	} else {
-		StoreHashEntry(pos, BestMove, alpha, HFALPHA, depth);
+		StoreHashEntry(pos, BestMove, alpha, StaticEval, HFALPHA, depth);
+	}
+
+	return alpha;
+}
+
+// InitRootMoves fills info->rootMoves with the legal moves (only the searchmoves if any were given),
+// in the usual move ordering with the hash move first
+static void InitRootMoves(S_BOARD *pos, S_SEARCHINFO *info) {
+
+	S_MOVELIST list[1];
+	S_ROOTMOVE *rm = NULL;
+	int MoveNum = 0;
+	int index = 0;
+	int found = FALSE;
+	int PvMove = ProbePvMove(pos);
+	int Move = NOMOVE;
+
+	GenerateAllMoves(pos,list);
+	info->rootCount = 0;
+
+	for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {
+		if(list->moves[MoveNum].move == PvMove) {
+			list->moves[MoveNum].score = 2000000;
+		}
+	}
+
+	for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {
+		PickNextMove(MoveNum, list);
+		Move = list->moves[MoveNum].move;
+		if(!MakeMove(pos, Move)) {
+			continue;
+		}
+		TakeMove(pos);
+
+		if(info->searchMovesCount > 0) {
+			found = FALSE;
+			for(index = 0; index < info->searchMovesCount; ++index) {
+				if(info->searchMoves[index] == Move) {
+					found = TRUE;
+					break;
+				}
+			}
+			if(found == FALSE) {
+				continue;
+			}
+		}
+
+		rm = &info->rootMoves[info->rootCount++];
+		rm->move = Move;
+		rm->score = -INFINITE;
+		rm->nodes = 0;
+		rm->pv[0] = Move;
+		rm->pvLength = 1;
+	}
+}
+
+// SortRootMoves orders the moves from first on by score, the moves that failed low all share
+// -INFINITE and are ordered by the nodes spent on them, a big subtree means a hard refutation
+static void SortRootMoves(S_SEARCHINFO *info, const int first) {
+
+	S_ROOTMOVE temp;
+	int index = 0;
+	int index2 = 0;
+
+	for(index = first + 1; index < info->rootCount; ++index) {
+		temp = info->rootMoves[index];
+		for(index2 = index; index2 > first; --index2) {
+			if(info->rootMoves[index2 - 1].score > temp.score ||
+			  (info->rootMoves[index2 - 1].score == temp.score && info->rootMoves[index2 - 1].nodes >= temp.nodes)) {
+				break;
+			}
+			info->rootMoves[index2] = info->rootMoves[index2 - 1];
+		}
+		info->rootMoves[index2] = temp;
+	}
+}
+
+// SearchRoot searches the root moves from pvIdx on, the ones before it are the better lines
+// already found in this iteration (MultiPV). Every move records its score, PV and node count.
+// The passes after the first mostly meet exact entries the first one stored under the same
+// moves, their PVs are complete because such a cutoff builds its line from the table.
+static int SearchRoot(int alpha, int beta, int depth, const int pvIdx, S_BOARD *pos, S_SEARCHINFO *info) {
+
+	ASSERT(CheckBoard(pos));
+	ASSERT(pos->ply == 0);
+
+	S_ROOTMOVE *rm = NULL;
+	int index = 0;
+	int Score = -INFINITE;
+	int BestMove = NOMOVE;
+	long nodesBefore = 0;
+
+	if(SqAttacked(pos->KingSq[pos->side],pos->side^1,pos)) {
+		depth++;
+	}
+
+	info->nodes++;
+
+	for(index = pvIdx; index < info->rootCount; ++index) {
+		rm = &info->rootMoves[index];
+		MakeMove(pos, rm->move);
+		nodesBefore = info->nodes;
+		Score = -AlphaBeta( -beta, -alpha, depth-1, pos, info, TRUE);
+		rm->nodes = info->nodes - nodesBefore;
+
+		if(info->stopped == TRUE) {
+			TakeMove(pos);
+			return 0;
+		}
+
+		TakeMove(pos);
+
+		if(Score > alpha) {
+			alpha = Score;
+			BestMove = rm->move;
+			rm->score = Score;
+			UpdatePv(pos, rm->move);
+			rm->pvLength = pos->pvLength[0] < MAXDEPTH ? pos->pvLength[0] : MAXDEPTH;
+			memcpy(rm->pv, pos->pvTable[0], sizeof(int) * rm->pvLength);
+		} else {
+			rm->score = -INFINITE;
+		}
+
+		if(BestMove == rm->move && !(rm->move & MFLAGCAP)) {
+			UpdateQuietHistory(pos, rm->move, HistoryBonus(depth));
+		}
+	}
+
+	if(BestMove != NOMOVE && pvIdx == 0) {
+		StoreHashEntry(pos, BestMove, alpha, NO_EVAL, HFEXACT, depth);
 	}
 
 	return alpha;
@@ -328,12 +729,19 @@ void SearchPosition(S_BOARD *pos, S_SEARCHINFO *info) {
 	int currentDepth = 0;
 	//currentDepth = 0;: Initializes the current search depth to 0. Depth is often used 
 	//in chess engines to control how many moves ahead the engine will consider.
-	int pvMoves = 0;
-	//to count the number of moves in the principal variation
 	int pvNum = 0;
+	int pvIdx = 0;
+	int multiPV = 1;
+	S_ROOTMOVE *rm = NULL;
+	long long iterationStart = 0;
+	char line[INFOBUFFER];
+	int lineLen = 0;
+	int hashFull = 0;
 
 	ClearForSearch(pos,info);
 	//The ClearForSearch function is used to reset or initialize certain values before starting a new search in the chess engine.
+	info->ponderMove = NOMOVE;
+	StartSearchTimer(info);
 	
 	if(EngineOptions->UseBook == TRUE) {
 		bestMove = GetBookMove(pos);
@@ -344,49 +752,105 @@ void SearchPosition(S_BOARD *pos, S_SEARCHINFO *info) {
 	// iterative deepening
 	//Purpose: The primary goal of iterative deepening in a chess engine is to search through the game's possible moves to a certain depth, 
 	//then gradually increase this depth and search again.
-	if(bestMove == NOMOVE) {//start the iterative deepening loop
+	if(bestMove == NOMOVE) {
+		InitRootMoves(pos, info);
+		multiPV = EngineOptions->MultiPV < info->rootCount ? EngineOptions->MultiPV : info->rootCount;
+	}
+
+	if(bestMove == NOMOVE && info->rootCount > 0) {//start the iterative deepening loop
 		for( currentDepth = 1; currentDepth <= info->depth; ++currentDepth ) {
-								// alpha	 beta
 			rootDepth = currentDepth;
-			bestScore = AlphaBeta(-INFINITE, INFINITE, currentDepth, pos, info, TRUE);
-	// for each depth, the AlphaBeta function is called to search the game tree to that depth and return the best move and score found.
+			iterationStart = ElapsedTime(info);
+			// each MultiPV line is a full window search of the root moves not already in a better line
+			for(pvIdx = 0; pvIdx < multiPV; ++pvIdx) {
+				SearchRoot(-INFINITE, INFINITE, currentDepth, pvIdx, pos, info);
+				if(info->stopped == TRUE) {
+					break;
+				}
+				SortRootMoves(info, pvIdx);
+				if(pvIdx == 0) {//the best line of this depth is complete, it is played even if the other lines are not
+					rm = &info->rootMoves[0];
+					bestMove = rm->move;
+					bestScore = rm->score;
+					info->ponderMove = rm->pvLength > 1 ? rm->pv[1] : NOMOVE;
+				}
+			}
 			if(info->stopped == TRUE) {
 				break;
 			}
 
-			pvMoves = GetPvLine(currentDepth, pos);
-			//After each depth iteration, it retrieves the principal variation line (pvMoves = GetPvLine(currentDepth, pos);) 
-			//which is the sequence of moves considered the best from the current position.
-			bestMove = pos->PvArray[0];
-			//get the next best move
-			if(info->GAME_MODE == UCIMODE) {
-				printf("info score cp %d depth %d nodes %ld time %d ",
-					bestScore,currentDepth,info->nodes,GetTimeMs()-info->starttime);
-			} else if(info->GAME_MODE == XBOARDMODE && info->POST_THINKING == TRUE) {
-				printf("%d %d %d %ld ",
-					currentDepth,bestScore,(GetTimeMs()-info->starttime)/10,info->nodes);
-			} else if(info->POST_THINKING == TRUE) {
-				printf("score:%d depth:%d nodes:%ld time:%d(ms) ",
-					bestScore,currentDepth,info->nodes,GetTimeMs()-info->starttime);
-			}
-			if(info->GAME_MODE == UCIMODE || info->POST_THINKING == TRUE) {
-				pvMoves = GetPvLine(currentDepth, pos);
-				if(!info->GAME_MODE == XBOARDMODE) {
-					printf("pv");
+			//the line is built first and printed with one call, in UCI mode the protocol thread may be answering the GUI at the same time
+			hashFull = info->GAME_MODE == UCIMODE ? HashFull(pos->HashTable) : 0;
+			for(pvIdx = 0; pvIdx < multiPV; ++pvIdx) {
+				rm = &info->rootMoves[pvIdx];
+				if(info->GAME_MODE == UCIMODE && multiPV > 1) {
+					lineLen = sprintf(line, "info score cp %d depth %d multipv %d nodes %ld time %lld hashfull %d pv",
+						rm->score,currentDepth,pvIdx+1,info->nodes,GetTimeMs()-info->starttime,hashFull);
+				} else if(info->GAME_MODE == UCIMODE) {
+					lineLen = sprintf(line, "info score cp %d depth %d nodes %ld time %lld hashfull %d pv",
+						rm->score,currentDepth,info->nodes,GetTimeMs()-info->starttime,hashFull);
+				} else if(pvIdx > 0) {//xboard and the console only show the best line
+					break;
+				} else if(info->GAME_MODE == XBOARDMODE && info->POST_THINKING == TRUE) {
+					lineLen = sprintf(line, "%d %d %lld %ld",
+						currentDepth,rm->score,(GetTimeMs()-info->starttime)/10,info->nodes);
+				} else if(info->POST_THINKING == TRUE) {
+					lineLen = sprintf(line, "score:%d depth:%d nodes:%ld time:%lld(ms)",
+						rm->score,currentDepth,info->nodes,GetTimeMs()-info->starttime);
 				}
-				for(pvNum = 0; pvNum < pvMoves; ++pvNum) {
-					printf(" %s",PrMove(pos->PvArray[pvNum]));
+				if(info->GAME_MODE == UCIMODE || info->POST_THINKING == TRUE) {
+					for(pvNum = 0; pvNum < rm->pvLength; ++pvNum) {
+						lineLen += sprintf(line + lineLen, " %s",PrMove(rm->pv[pvNum]));
+					}
+					printf("%s\n", line);
 				}
-				printf("\n");
 			}
 
-			//printf("Hits:%d Overwrite:%d NewWrite:%d Cut:%d\nOrdering %.2f NullCut:%d\n",pos->HashTable->hit,pos->HashTable->overWrite,pos->HashTable->newWrite,pos->HashTable->cut,
+			if(StopAfterIteration(info, bestMove, bestScore, ElapsedTime(info) - iterationStart)) {
+				break;
+			}
+
+			//printf("Hits:%ld Overwrite:%ld NewWrite:%ld Cut:%ld\nOrdering %.2f NullCut:%d\n",pos->hashStats.hit,pos->hashStats.overWrite,pos->hashStats.newWrite,pos->hashStats.cut,
 			//(info->fhf/info->fh)*100,info->nullCut);
 		}
 	}
 
+	//a search that ends by itself while pondering may not answer before ponderhit or stop
+	while(info->ponder == TRUE && info->stopped == FALSE) {
+		if(info->GAME_MODE != UCIMODE) {
+			ReadInput(info);
+		}
+		SleepMs(1);
+	}
+
+	if(bestMove == NOMOVE && info->rootCount > 0) {//stopped before the first iteration finished
+		bestMove = info->rootMoves[0].move;
+	}
+
+	if(info->ponderMove == NOMOVE && bestMove != NOMOVE) {//a one move PV, or a book move
+		info->ponderMove = PonderFromHash(pos, bestMove);
+	}
+
+	StopSearchTimer();
+	info->searchMovesCount = 0;//searchmoves only apply to the go command that gave them
+
 	if(info->GAME_MODE == UCIMODE) {
-		printf("bestmove %s\n",PrMove(bestMove));
+		//where the static evals of this search came from, the hash table or EvalPositionLazy
+		lineLen = sprintf(line, "info string eval %ld from hash %ld computed %ld lazy",
+			pos->evalStats.hashEval,pos->evalStats.computed,pos->evalStats.lazy);
+		if(pos->evalStats.lazyChecked > 0) {
+			sprintf(line + lineLen, " %ld of %ld checked wrong",pos->evalStats.lazyWrong,pos->evalStats.lazyChecked);
+		}
+		printf("%s\n", line);
+		//PrMove returns a static buffer, so the two moves are printed into the line one at a time
+		lineLen = sprintf(line, "bestmove %s",PrMove(bestMove));
+		if(info->ponderMove != NOMOVE) {
+			sprintf(line + lineLen, " ponder %s",PrMove(info->ponderMove));
+		}
+		printf("%s\n", line);
+	} else if(info->ponder == TRUE) {
+		//an xboard ponder search only warms the hash table, nothing is played
+		return;
 	} else if(info->GAME_MODE == XBOARDMODE) {
 		printf("move %s\n",PrMove(bestMove));
 		MakeMove(pos, bestMove);
@@ -0,0 +1,110 @@
+// timeman.c
+
+#include "stdio.h"
+#include "defs.h"
+
+#define MOVESTOGO_MAX 50 // sudden death games are planned as if this many moves were left
+#define MAX_TIME_FACTOR 5 // the hard limit is at most this many times the optimum
+#define NEXT_ITERATION_FACTOR 2 // an iteration takes about this many times as long as the one before it
+
+// SetTimeLimits starts the search clock and works out how long to think.
+// time is what is left on our clock and movetime a fixed time for this move, -1 when not given.
+// The optimum (soft) limit is checked between iterations, the maximum (hard) limit becomes
+// stoptime and is enforced by the timer thread in the middle of an iteration.
+void SetTimeLimits(S_SEARCHINFO *info, const int time, const int inc, const int movestogo, const int movetime) {
+
+	long long available, limit;
+	int mtg = movestogo;
+
+	info->starttime = GetTimeMs();
+	info->timeset = FALSE;
+	info->fixedTime = FALSE;
+	info->nodeLimit = 0;
+	info->nodesTime = EngineOptions->NodesTime;
+
+	if(movetime != -1) {
+		info->timeset = TRUE;
+		info->fixedTime = TRUE;
+		info->maximumTime = movetime - EngineOptions->MoveOverhead;
+		if(info->maximumTime < 1) info->maximumTime = 1;
+		info->optimumTime = info->maximumTime;
+	} else if(time != -1) {
+		info->timeset = TRUE;
+		if(mtg < 1) mtg = 1;
+		if(mtg > MOVESTOGO_MAX) mtg = MOVESTOGO_MAX;
+
+		// the increments still to come are ours to spend, the overhead is lost on every move
+		available = time + (long long)inc * (mtg - 1) - (long long)EngineOptions->MoveOverhead * mtg;
+		if(available < 1) available = 1;
+		info->optimumTime = available / mtg;
+		if(EngineOptions->Ponder == TRUE) {
+			info->optimumTime += info->optimumTime / 4; // part of the thinking happens on the opponent's time
+		}
+
+		// keep a reserve on the clock unless this is the last move before the time control
+		limit = time - EngineOptions->MoveOverhead;
+		if(mtg > 1) limit = limit * 8 / 10;
+		if(limit < 1) limit = 1;
+
+		info->maximumTime = info->optimumTime * MAX_TIME_FACTOR;
+		if(info->maximumTime > limit) info->maximumTime = limit;
+		if(info->optimumTime > info->maximumTime) info->optimumTime = info->maximumTime;
+	}
+
+	if(info->timeset == TRUE) {
+		info->stoptime = info->starttime + info->maximumTime;
+		if(info->nodesTime != 0) {// the hard limit becomes a node budget, the timer thread is not used
+			info->nodeLimit = info->maximumTime * info->nodesTime;
+		}
+	}
+}
+
+// ElapsedTime is the time spent on this search in ms, with nodestime it is counted in nodes
+// so that every decision of the time manager can be replayed exactly
+long long ElapsedTime(const S_SEARCHINFO *info) {
+	if(info->nodesTime != 0) {
+		return info->nodes / info->nodesTime;
+	}
+	return GetTimeMs() - info->starttime;
+}
+
+// StopAfterIteration is called after each completed iteration and says whether to start another.
+// The optimum is stretched while the best move keeps changing or the score is falling and shrunk
+// once the best move has stayed the same for a few iterations. An iteration that would run into
+// the hard limit is not started, its unfinished result would be thrown away.
+int StopAfterIteration(S_SEARCHINFO *info, const int bestMove, const int bestScore, const long long iterationTime) {
+
+	long long elapsed, soft;
+	int scale, drop;
+
+	if(bestMove == info->lastBestMove) {
+		info->bestMoveStable++;
+	} else {
+		info->bestMoveStable = 0;
+	}
+	drop = info->lastBestMove == NOMOVE ? 0 : info->lastScore - bestScore;
+	info->lastBestMove = bestMove;
+	info->lastScore = bestScore;
+
+	if(info->timeset == FALSE || info->ponder == TRUE) {
+		return FALSE;
+	}
+
+	elapsed = ElapsedTime(info);
+	if(elapsed + iterationTime * NEXT_ITERATION_FACTOR > info->maximumTime) {
+		return TRUE;
+	}
+
+	if(info->fixedTime == TRUE) {// a fixed move time is used in full
+		return FALSE;
+	}
+
+	scale = 140 - 10 * (info->bestMoveStable < 6 ? info->bestMoveStable : 6); // 140% just after a change, 80% when settled
+	if(drop > 0) {
+		scale += drop < 50 ? drop : 50; // up to half as much again while the score falls
+	}
+	soft = info->optimumTime * scale / 100;
+	if(soft > info->maximumTime) soft = info->maximumTime;
+
+	return elapsed >= soft;
+}
@@ -3,16 +3,92 @@
 #include "stdio.h"
 #include "defs.h"
 #include "string.h"
+#include "pthread.h"
+
+#define SEARCH_STACK_SIZE (8 * 1024 * 1024)
+
+// The search runs on a worker thread so this thread keeps reading the GUI while it thinks.
+// Only the UCI thread starts and joins the worker, so searchRunning needs no locking.
+typedef struct {
+	S_BOARD *pos;
+	S_SEARCHINFO *info;
+} S_SEARCHTHREAD;
+
+static pthread_t searchThread;
+static S_SEARCHTHREAD searchArgs[1];
+static int searchRunning = FALSE;
+static int pendingHashMB = 0;
+
+static void *SearchThreadMain(void *arg) {
+	S_SEARCHTHREAD *args = (S_SEARCHTHREAD *)arg;
+	SearchPosition(args->pos, args->info);
+	return NULL;
+}
+
+static void StartSearch(S_BOARD *pos, S_SEARCHINFO *info) {
+	pthread_attr_t attr;
+
+	searchArgs->pos = pos;
+	searchArgs->info = info;
+	info->stopped = FALSE;//cleared here, a stop read while the worker starts up must not be lost
 
-#define INPUTBUFFER 400 * 6
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, SEARCH_STACK_SIZE);
+	if(pthread_create(&searchThread, &attr, SearchThreadMain, searchArgs) == 0) {
+		searchRunning = TRUE;
+	} else {
+		SearchPosition(pos, info);
+	}
+	pthread_attr_destroy(&attr);
+}
+
+// WaitForSearch joins a finished (or stopping) search and applies the options that had to wait for it
+static void WaitForSearch(S_BOARD *pos) {
+	if(searchRunning == TRUE) {
+		pthread_join(searchThread, NULL);
+		searchRunning = FALSE;
+	}
+	if(pendingHashMB != 0) {
+		StartHashResize(pos->HashTable, pendingHashMB);
+		pendingHashMB = 0;
+	}
+}
+
+// PonderHit: the opponent played the expected move, the ponder search becomes the normal
+// search and the clock starts now with the budget ParseGo set for it
+static void PonderHit(S_SEARCHINFO *info) {
+	long long now = GetTimeMs();
+
+	if(searchRunning == FALSE || info->ponder == FALSE) {
+		return;
+	}
+	info->stoptime += now - info->starttime;
+	info->starttime = now;
+	info->ponder = FALSE;//written last, the timer thread reads stoptime only once it sees this
+}
+
+static void StopSearch(S_BOARD *pos, S_SEARCHINFO *info) {
+	if(searchRunning == TRUE) {
+		info->stopped = TRUE;
+	}
+	WaitForSearch(pos);
+}
 
 // go depth 6 wtime 180000 btime 100000 binc 1000 winc 1000 movetime 1000 movestogo 40
+// go ponder wtime 180000 btime 100000 (search the position after the expected reply)
+// go infinite searchmoves e2e4 d2d4 (only search the listed root moves)
 void ParseGo(char* line, S_SEARCHINFO *info, S_BOARD *pos) {
 
 	int depth = -1, movestogo = 30,movetime = -1;
 	int time = -1, inc = 0;
+	long nodes = -1;
+	int move = NOMOVE;
     char *ptr = NULL;
-	info->timeset = FALSE;
+	info->ponder = FALSE;
+
+	if ((ptr = strstr(line,"ponder"))) {
+		info->ponder = TRUE;
+	}
 
 	if ((ptr = strstr(line,"infinite"))) {
 		;
@@ -46,28 +122,37 @@ void ParseGo(char* line, S_SEARCHINFO *info, S_BOARD *pos) {
 		depth = atoi(ptr + 6);
 	}
 
-	if(movetime != -1) {
-		time = movetime;
-		movestogo = 1;
+	if ((ptr = strstr(line,"nodes"))) {
+		nodes = atol(ptr + 6);
 	}
 
-	info->starttime = GetTimeMs();
-	info->depth = depth;
-
-	if(time != -1) {
-		info->timeset = TRUE;
-		time /= movestogo;
-		time -= 50;
-		info->stoptime = info->starttime + time + inc;
+	info->searchMovesCount = 0;
+	if ((ptr = strstr(line,"searchmoves"))) {
+		ptr += 12;
+		while(*ptr && info->searchMovesCount < MAXPOSITIONMOVES) {
+			move = ParseMove(ptr, pos);
+			if(move == NOMOVE) break;
+			info->searchMoves[info->searchMovesCount++] = move;
+			while(*ptr && *ptr != ' ') ptr++;
+			while(*ptr == ' ') ptr++;
+		}
 	}
 
+	info->depth = depth;
+
 	if(depth == -1) {
 		info->depth = MAXDEPTH;
 	}
 
-	printf("time:%d start:%d stop:%d depth:%d timeset:%d\n",
-		time,info->starttime,info->stoptime,info->depth,info->timeset);
-	SearchPosition(pos, info);
+	SetTimeLimits(info, time, inc, movestogo, movetime);
+
+	if(nodes > 0 && (info->nodeLimit == 0 || nodes < info->nodeLimit)) {
+		info->nodeLimit = nodes;
+	}
+
+	printf("time:%d start:%lld optimum:%lld maximum:%lld depth:%d timeset:%d nodes:%ld\n",
+		time,info->starttime,info->optimumTime,info->maximumTime,info->depth,info->timeset,info->nodeLimit);
+	StartSearch(pos, info);
 }
 
 // position fen fenstr
@@ -128,39 +213,81 @@ void Uci_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 	//  This specifies that the default value for the "Hash" option is 64. This means that unless the user or the GUI specifies otherwise, the chess engine will use a hash table size of 64 (the unit is typically megabytes
 	//  This sets the minimum allowable value for the "Hash" option to 4. The user or the GUI cannot set the hash table size to less than this value
 	printf("option name Book type check default true\n");
+	printf("option name Ponder type check default false\n");
+	printf("option name Move Overhead type spin default %d min 0 max 5000\n",MOVE_OVERHEAD);
+	printf("option name nodestime type spin default 0 min 0 max 10000\n");
+	printf("option name MultiPV type spin default 1 min 1 max %d\n",MAX_MULTIPV);
+	printf("option name LazyMargin type spin default %d min 0 max 2000\n",LAZY_MARGIN);
+	printf("option name LazyCheck type check default false\n");
     printf("uciok\n");
 	
 	int MB = 64;
 
+	// Commands that only touch the protocol state are answered at once, even while the
+	// worker thread is searching. Commands that change the board wait for the search to end,
+	// a stop is sent first for the ones that make the running search pointless.
 	while (TRUE) {
 		memset(&line[0], 0, sizeof(line));
 		// clears the input buffer to ensure no residual 
 		//data affects the current read operation.
         fflush(stdout);
-        if (!fgets(line, INPUTBUFFER, stdin))
-        continue;
+        if (!fgets(line, INPUTBUFFER, stdin)) {//the GUI has gone away
+            StopSearch(pos, info);
+            info->quit = TRUE;
+            break;
+        }
 
         if (line[0] == '\n')
         continue;
 
-        if (!strncmp(line, "isready", 7)) {
+        if (!strncmp(line, "isready", 7)) {//a clear or resize still running is waited for by the next go, not here
             printf("readyok\n");
             continue;
+        } else if (!strncmp(line, "stop", 4)) {
+            StopSearch(pos, info);
+        } else if (!strncmp(line, "ponderhit", 9)) {
+            PonderHit(info);
         } else if (!strncmp(line, "position", 8)) {
+            StopSearch(pos, info);
             ParsePosition(line, pos);
         } else if (!strncmp(line, "ucinewgame", 10)) {
+            StopSearch(pos, info);
+            ClearSearchHistory(pos);
+            StartHashClear(pos->HashTable);
             ParsePosition("position startpos\n", pos);
         } else if (!strncmp(line, "go", 2)) {
+            StopSearch(pos, info);
+            WaitForHashJob();//before the clock starts, a clear or resize still running owns the table
             printf("Seen Go..\n");
             ParseGo(line, info, pos);
         } else if (!strncmp(line, "quit", 4)) {
+            StopSearch(pos, info);
             info->quit = TRUE;
             break;
         } else if (!strncmp(line, "uci", 3)) {
             printf("id name %s\n",NAME);
             printf("id author Bluefever\n");
             printf("uciok\n");
+        } else if (!strncmp(line, "savehash ", 9)) {
+            StopSearch(pos, info);
+            WaitForHashJob();
+            line[strcspn(line, "\r\n")] = '\0';
+            SaveHashTable(pos->HashTable, line + 9);
+        } else if (!strncmp(line, "loadhash ", 9)) {
+            StopSearch(pos, info);
+            WaitForHashJob();
+            line[strcspn(line, "\r\n")] = '\0';
+            LoadHashTable(pos->HashTable, line + 9);
+        } else if (!strncmp(line, "bench", 5)) {
+            StopSearch(pos, info);
+            WaitForHashJob();
+            int depth = BENCH_DEPTH;
+            sscanf(line, "bench %d", &depth);
+            Bench(pos, info, depth);
+            ParsePosition("position startpos\n", pos);
         } else if (!strncmp(line, "debug", 4)) {
+            StopSearch(pos, info);
+            WaitForHashJob();
             DebugAnalysisTest(pos,info);
             break;
         } else if (!strncmp(line, "setoption name Hash value ", 26)) {			
@@ -168,7 +295,11 @@ void Uci_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 			if(MB < 4) MB = 4;
 			if(MB > MAX_HASH) MB = MAX_HASH;
 			printf("Set Hash to %d MB\n",MB);
-			InitHashTable(pos->HashTable, MB);
+			if(searchRunning == TRUE) {//the table is in use, resize it once the search is over
+				pendingHashMB = MB;
+			} else {
+				StartHashResize(pos->HashTable, MB);
+			}
 		} else if (!strncmp(line, "setoption name Book value ", 26)) {			
 			char *ptrTrue = NULL;
 			ptrTrue = strstr(line, "true");
@@ -177,6 +308,26 @@ void Uci_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 			} else {
 				EngineOptions->UseBook = FALSE;
 			}
+		} else if (!strncmp(line, "setoption name Move Overhead value ", 35)) {
+			sscanf(line + 35, "%d", &EngineOptions->MoveOverhead);
+			if(EngineOptions->MoveOverhead < 0) EngineOptions->MoveOverhead = 0;
+			if(EngineOptions->MoveOverhead > 5000) EngineOptions->MoveOverhead = 5000;
+		} else if (!strncmp(line, "setoption name MultiPV value ", 29)) {
+			sscanf(line + 29, "%d", &EngineOptions->MultiPV);
+			if(EngineOptions->MultiPV < 1) EngineOptions->MultiPV = 1;
+			if(EngineOptions->MultiPV > MAX_MULTIPV) EngineOptions->MultiPV = MAX_MULTIPV;
+		} else if (!strncmp(line, "setoption name nodestime value ", 31)) {
+			sscanf(line + 31, "%d", &EngineOptions->NodesTime);
+			if(EngineOptions->NodesTime < 0) EngineOptions->NodesTime = 0;
+			if(EngineOptions->NodesTime > 10000) EngineOptions->NodesTime = 10000;
+		} else if (!strncmp(line, "setoption name LazyMargin value ", 32)) {
+			sscanf(line + 32, "%d", &EngineOptions->LazyMargin);
+			if(EngineOptions->LazyMargin < 0) EngineOptions->LazyMargin = 0;
+			if(EngineOptions->LazyMargin > 2000) EngineOptions->LazyMargin = 2000;
+		} else if (!strncmp(line, "setoption name LazyCheck value ", 31)) {
+			EngineOptions->LazyCheck = strstr(line, "true") != NULL ? TRUE : FALSE;
+		} else if (!strncmp(line, "setoption name Ponder value ", 28)) {
+			EngineOptions->Ponder = strstr(line, "true") != NULL ? TRUE : FALSE;
 		}
 		if(info->quit) break;
     }
@@ -61,7 +61,6 @@ void DebugAnalysisTest(S_BOARD *pos, S_SEARCHINFO *info) {
     char lineIn [1024];
 
 	info->depth = MAXDEPTH;
-	info->timeset = TRUE;
 	int time = 1140000;
 
 
@@ -70,12 +69,11 @@ void DebugAnalysisTest(S_BOARD *pos, S_SEARCHINFO *info) {
         return;
     }  else {
         while(fgets (lineIn , 1024 , file) != NULL) {
-			info->starttime = GetTimeMs();
-			info->stoptime = info->starttime + time;
+			SetTimeLimits(info, -1, 0, 1, time);
 			ClearHashTable(pos->HashTable);
             ParseFen(lineIn, pos);
             printf("\n%s\n",lineIn);
-			printf("time:%d start:%d stop:%d depth:%d timeset:%d\n",
+			printf("time:%d start:%lld stop:%lld depth:%d timeset:%d\n",
 				time,info->starttime,info->stoptime,info->depth,info->timeset);
 			SearchPosition(pos, info);
             memset(&lineIn[0], 0, sizeof(lineIn));
@@ -122,3 +120,74 @@ void MirrorEvalTest(S_BOARD *pos) {
     }
 }
 
+
+// Bench searches a fixed set of positions to a fixed depth from a cleared hash table and
+// history, with no clock and no input polling, so the node count is the same on every run
+// of the same build and a change in it means the search changed
+static const char *BenchFens[] = {
+	START_FEN,
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r1b1k2r/ppppnppp/2n2q2/2b5/3NP3/2P1B3/PP3PPP/RN1QKB1R w KQkq - 0 1",
+	"2r3k1/pp3ppp/8/3R4/8/8/PPP2PPP/6K1 w - - 0 1",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"8/8/4k3/8/2p5/8/B2K4/8 w - - 0 1",
+	"8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1"
+};
+
+void Bench(S_BOARD *pos, S_SEARCHINFO *info, const int depth) {
+
+	int index = 0;
+	int useBook = EngineOptions->UseBook;
+	int multiPV = EngineOptions->MultiPV;
+	int gameMode = info->GAME_MODE;
+	long long nodes = 0;
+	long long start = GetTimeMs();
+	long long elapsed = 0;
+	S_HASHSTATS stats = {0, 0, 0, 0};
+	S_EVALSTATS evalStats = {0, 0, 0, 0, 0};
+
+	EngineOptions->UseBook = FALSE;
+	EngineOptions->MultiPV = 1;
+	info->GAME_MODE = UCIMODE;//report with info lines and leave the board alone
+	info->ponder = FALSE;
+	ClearPawnTable(pos->PawnTable);
+	ClearMaterialTable(pos->MaterialTable);
+
+	for(index = 0; index < (int)(sizeof(BenchFens) / sizeof(BenchFens[0])); ++index) {
+		ParseFen((char *)BenchFens[index], pos);
+		ClearHashTable(pos->HashTable);
+		ClearSearchHistory(pos);
+		SetTimeLimits(info, -1, 0, 1, -1);
+		info->nodesTime = 0;
+		info->stopped = FALSE;//in UCI mode the search leaves the flag to StartSearch
+		info->depth = depth;
+		printf("\nPosition %d: %s\n", index + 1, BenchFens[index]);
+		SearchPosition(pos, info);
+		nodes += info->nodes;
+		AddHashStats(&stats, &pos->hashStats);
+		AddEvalStats(&evalStats, &pos->evalStats);
+	}
+
+	elapsed = GetTimeMs() - start;
+	printf("\n===========================\n");
+	printf("Depth          : %d\n", depth);
+	printf("Total time (ms): %lld\n", elapsed);
+	printf("Nodes searched : %lld\n", nodes);
+	printf("Nodes/second   : %lld\n", nodes * 1000 / (elapsed > 0 ? elapsed : 1));
+	printf("Hash hits      : %ld (%ld cutoffs)\n", stats.hit, stats.cut);
+	printf("Hash stores    : %ld new, %ld replaced\n", stats.newWrite, stats.overWrite);
+	printf("Pawn hash      : %ld hits, %ld misses\n", pos->PawnTable->hit, pos->PawnTable->miss);
+	printf("Material hash  : %ld hits, %ld misses\n", pos->MaterialTable->hit, pos->MaterialTable->miss);
+	printf("Static eval    : %ld from the hash table, %ld computed (%.1f%% reused)\n", evalStats.hashEval, evalStats.computed,
+		100.0 * evalStats.hashEval / (evalStats.hashEval + evalStats.computed > 0 ? evalStats.hashEval + evalStats.computed : 1));
+	printf("Lazy eval      : %ld early exits (margin %d)", evalStats.lazy, EngineOptions->LazyMargin);
+	if(evalStats.lazyChecked > 0) {
+		printf(", %ld of %ld checked ones wrong", evalStats.lazyWrong, evalStats.lazyChecked);
+	}
+	printf("\n");
+
+	EngineOptions->UseBook = useBook;
+	EngineOptions->MultiPV = multiPV;
+	info->GAME_MODE = gameMode;
+}
@@ -16,8 +16,24 @@ int main(int argc, char *argv[]) {
 	S_BOARD pos[1];
     S_SEARCHINFO info[1];
     info->quit = FALSE;
-	pos->HashTable->pTable = NULL;
+    info->ponder = FALSE;
+    info->nodeLimit = 0;
+    info->nodesTime = 0;
+    info->searchMovesCount = 0;
+    EngineOptions->Ponder = FALSE;
+    EngineOptions->MoveOverhead = MOVE_OVERHEAD;
+    EngineOptions->NodesTime = 0;
+    EngineOptions->MultiPV = 1;
+    EngineOptions->LazyMargin = LAZY_MARGIN;
+    EngineOptions->LazyCheck = FALSE;
+	S_HASHTABLE table[1];
+	table->pTable = NULL;
+	table->mapping = NULL;
+	pos->HashTable = table;
+	pos->PawnTable = NewPawnTable();
+	pos->MaterialTable = NewMaterialTable();
     InitHashTable(pos->HashTable, 64);
+	ClearSearchHistory(pos);
 	setbuf(stdin, NULL);
     setbuf(stdout, NULL);
     
@@ -30,6 +46,16 @@ int main(int argc, char *argv[]) {
     	}
     }
 
+	//vice bench [depth] prints a reproducible node count for comparing builds and exits
+	if(argc > 1 && strncmp(argv[1], "bench", 5) == 0) {
+		Bench(pos, info, argc > 2 ? atoi(argv[2]) : BENCH_DEPTH);
+		FreeHashTable(pos->HashTable);
+		FreePawnTable(pos->PawnTable);
+		FreeMaterialTable(pos->MaterialTable);
+		CleanPolyBook();
+		return 0;
+	}
+
 	printf("Welcome to Vice! Type 'vice' for console mode...\n");
 
 	char line[256];
@@ -58,7 +84,10 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	free(pos->HashTable->pTable);
+	WaitForHashJob();
+	FreeHashTable(pos->HashTable);
+	FreePawnTable(pos->PawnTable);
+	FreeMaterialTable(pos->MaterialTable);
 	CleanPolyBook();
 	return 0;
 }
@@ -76,6 +76,32 @@ int checkresult(S_BOARD *pos) {
 	return FALSE;
 }
 
+// Ponder thinks on the opponent's time about the reply the last search expects.
+// xboard has no ponderhit, so the search just runs until the next command arrives
+// and the real search afterwards picks its results up from the hash table.
+static void Ponder(S_BOARD *pos, S_SEARCHINFO *info) {
+	int move = info->ponderMove;
+
+	if(move == NOMOVE || !MoveExists(pos, move)) {
+		return;
+	}
+	MakeMove(pos, move);
+	pos->ply = 0;
+
+	info->ponder = TRUE;
+	info->timeset = FALSE;
+	info->nodeLimit = 0;
+	info->depth = MAXDEPTH;
+	WaitForHashJob();
+	info->starttime = GetTimeMs();
+	SearchPosition(pos, info);
+	info->ponder = FALSE;
+
+	pos->ply = 1;//the search leaves ply at 0, TakeMove steps back over the ponder move
+	TakeMove(pos);
+	pos->ply = 0;
+}
+
 void PrintOptions() {
 	printf("feature ping=1 setboard=1 colors=0 usermove=1 memory=1\n");
 	printf("feature done=1\n");
@@ -109,22 +135,18 @@ void XBoard_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 		fflush(stdout);
 
 		if(pos->side == engineSide && checkresult(pos) == FALSE) {
-			info->starttime = GetTimeMs();
 			info->depth = depth;
 
-			if(time != -1) {
-				info->timeset = TRUE;
-				time /= movestogo[pos->side];
-				time -= 50;
-				info->stoptime = info->starttime + time + inc;
-			}
-
 			if(depth == -1 || depth > MAXDEPTH) {
 				info->depth = MAXDEPTH;
 			}
 
-			printf("time:%d start:%d stop:%d depth:%d timeset:%d movestogo:%d mps:%d\n",
-				time,info->starttime,info->stoptime,info->depth,info->timeset, movestogo[pos->side], mps);
+			//the level increment is given in seconds
+			WaitForHashJob();
+			SetTimeLimits(info, time, inc * 1000, movestogo[pos->side], -1);
+
+			printf("time:%d start:%lld optimum:%lld maximum:%lld depth:%d timeset:%d movestogo:%d mps:%d\n",
+				time,info->starttime,info->optimumTime,info->maximumTime,info->depth,info->timeset, movestogo[pos->side], mps);
 				SearchPosition(pos, info);
 
 			if(mps != 0) {
@@ -134,13 +156,17 @@ void XBoard_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 				}
 			}
 
+			if(EngineOptions->Ponder == TRUE) {
+				Ponder(pos, info);
+			}
+
 		}
 
 		fflush(stdout);
 
 		memset(&inBuf[0], 0, sizeof(inBuf));
 		fflush(stdout);
-		if (!fgets(inBuf, 80, stdin))
+		if (!ReadInputLine(inBuf, 80))
 		continue;
 
 		sscanf(inBuf, "%s", command);
@@ -157,6 +183,16 @@ void XBoard_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 			continue;
 		}
 
+		if(!strcmp(command, "hard")) {
+			EngineOptions->Ponder = TRUE;
+			continue;
+		}
+
+		if(!strcmp(command, "easy")) {
+			EngineOptions->Ponder = FALSE;
+			continue;
+		}
+
 		if(!strcmp(command, "protover")){
 			PrintOptions();
 		    continue;
@@ -186,7 +222,7 @@ void XBoard_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 		    if(MB < 4) MB = 4;
 			if(MB > MAX_HASH) MB = MAX_HASH;
 			printf("Set Hash to %d MB\n",MB);
-			InitHashTable(pos->HashTable, MB);
+			StartHashResize(pos->HashTable, MB);//no search is running here, the next one waits for the resize
 			continue;
 		}
 
@@ -216,7 +252,8 @@ void XBoard_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 		}
 
 		if(!strcmp(command, "new")) {
-			ClearHashTable(pos->HashTable);
+			StartHashClear(pos->HashTable);
+			ClearSearchHistory(pos);
 			engineSide = BLACK;
 			ParseFen(START_FEN, pos);
 			depth = -1;
@@ -269,13 +306,9 @@ void Console_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 		fflush(stdout);
 
 		if(pos->side == engineSide && checkresult(pos) == FALSE) {
-			info->starttime = GetTimeMs();
 			info->depth = depth;
-
-			if(movetime != 0) {
-				info->timeset = TRUE;
-				info->stoptime = info->starttime + movetime;
-			}
+			WaitForHashJob();
+			SetTimeLimits(info, -1, 0, 1, movetime != 0 ? movetime : -1);
 
 			SearchPosition(pos, info);
 		}
@@ -286,7 +319,7 @@ void Console_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 
 		memset(&inBuf[0], 0, sizeof(inBuf));
 		fflush(stdout);
-		if (!fgets(inBuf, 80, stdin))
+		if (!ReadInputLine(inBuf, 80))
 		continue;
 
 		sscanf(inBuf, "%s", command);
@@ -378,7 +411,8 @@ void Console_Loop(S_BOARD *pos, S_SEARCHINFO *info) {
 		}
 
 		if(!strcmp(command, "new")) {
-			ClearHashTable(pos->HashTable);
+			StartHashClear(pos->HashTable);
+			ClearSearchHistory(pos);
 			engineSide = BLACK;
 			ParseFen(START_FEN, pos);
 			continue;